@@ -0,0 +1,84 @@
+#ifndef SIO_Capture_INCLUDED
+#define SIO_Capture_INCLUDED
+
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "Poco/Mutex.h"
+#include "Poco/SingletonHolder.h"
+#include "Poco/Types.h"
+
+//A captured frame. The capture file is a SIOCaptureHeader followed by
+//these records, each followed by its length bytes of data, read back by
+//src/tools/sio_replay.
+struct SIOCaptureRecord
+{
+	Poco::UInt64 timestamp;//microseconds since the epoch
+	Poco::UInt32 connection;//same id as in wire traces and metrics
+	Poco::UInt32 length;//bytes of data following the record
+	Poco::UInt8 type;//SIOCapture::Type
+	Poco::UInt8 flags;//first byte of the frame: FIN, RSV and opcode
+	Poco::UInt16 endpoint;//namespace id, 0 outside of a namespace (heartbeats, pings)
+};
+
+struct SIOCaptureHeader
+{
+	char magic[8];//"SIOCAPTR"
+	Poco::UInt32 version;//2, 1 had no namespace ids
+	Poco::UInt32 recordSize;
+};
+
+//Process wide capture of whole websocket frames, for replaying real traffic
+//offline. Unlike SIOTracer nothing is cut nor dropped: frames are appended
+//to a buffered file under a mutex, which is fine for recording a session to
+//benchmark against but not meant to stay on in production.
+class SIOCapture
+{
+private:
+	friend class Poco::SingletonHolder<SIOCapture>;
+
+	SIOCapture();
+	~SIOCapture();
+
+	std::atomic<bool> _enabled;
+	FILE *_file;
+	std::map<std::string, Poco::UInt16> _endpoints;//namespace ids given so far
+	Poco::FastMutex _mutex;
+
+public:
+	enum Type
+	{
+		IN,//frame received, after inflating
+		OUT,//frame written, before compression
+		OPEN,//websocket opened, data is "<protocol> <uri>" with protocol 0.9 or 1.0
+		ENDPOINT//precedes the first frame of a namespace, data is the namespace
+	};
+
+	enum
+	{
+		NO_ENDPOINT = 0,
+		MAX_ENDPOINTS = 0xFFFF//later namespaces are recorded as NO_ENDPOINT
+	};
+
+	static SIOCapture *instance();
+
+	bool start(const std::string &path);
+	void stop();
+
+	bool enabled() const {return _enabled.load(std::memory_order_relaxed);};
+
+	//frame made of head followed by data, head may be empty. endpoint is the
+	//namespace of the frame, NULL outside of one; ids are given process wide
+	//in order of first use, each announced by an ENDPOINT record
+	void record(Poco::UInt32 connection, Type type, int flags, const char *endpoint, std::size_t endpointSize,
+		const char *head, std::size_t headSize, const char *data, std::size_t size);
+
+private:
+	//with _mutex held
+	void write(Poco::UInt32 connection, Type type, int flags, Poco::UInt16 endpoint,
+		const char *head, std::size_t headSize, const char *data, std::size_t size);
+};
+
+#endif
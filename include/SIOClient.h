@@ -1,6 +1,9 @@
 #ifndef SIO_Client_INCLUDED
 #define SIO_Client_INCLUDED
 
+#include <atomic>
+#include <set>
+
 #include "SIOClientImpl.h"
 
 #include "Poco/JSON/Array.h"
@@ -12,6 +15,10 @@ class SIOClient
 private:
 	~SIOClient();
 
+	//the one connect() hands out, dropped by disconnect(), and those of
+	//the registry lookups still using the client
+	std::atomic<int> _refCount;
+
 	SIOClientImpl *_socket;
 	
 	std::string _uri;
@@ -22,17 +29,58 @@ private:
 	SIOEventRegistry *_registry;
 	SIONotificationHandler *_sioHandler; 
 
+	std::set<std::string> _volatileEvents;
+	std::set<std::string> _coalescedEvents;
+	std::set<std::string> _droppableEvents;
+	Poco::FastMutex _coalescedMutex;//guards both sets, read by the receive thread
+
 public:
 
 
 	SIOClient(std::string uri, std::string endpoint, SIOClientImpl *impl);
 
 	static SIOClient* connect(std::string uri);
+	//the config is only used when a new socket to the host has to be opened
+	static SIOClient* connect(std::string uri, const SIOConfig &config);
 	void disconnect();
-	void send(std::string s);
-	void emit(std::string eventname, std::string args);
-  void emit(std::string eventname, Poco::JSON::Object::Ptr args);
+	//reference counted like SIOClientImpl, for Poco::AutoPtr
+	void duplicate();
+	void release();
+	bool tryDuplicate();
+	//false when the message could not be sent nor buffered for later
+	bool send(std::string s);
+	bool emit(std::string eventname, std::string args);
+  bool emit(std::string eventname, Poco::JSON::Object::Ptr args);
+	//false right away, without queueing, while the socket is above its high
+	//watermark; wait for the "drain" event before emitting again
+	bool tryEmit(std::string eventname, std::string args);
+	bool tryEmit(std::string eventname, Poco::JSON::Object::Ptr args);
+	//latest value wins: replaces the emit of the same event and key that is
+	//still waiting to be written, for state where only the newest value matters
+	bool emitLatest(std::string eventname, std::string key, std::string args);
+	bool emitLatest(std::string eventname, std::string key, Poco::JSON::Object::Ptr args);
+	//bytes of this socket waiting to be written
+	std::size_t bufferedAmount();
+	//volatile events are dropped instead of buffered while disconnected or
+	//while the socket is above its high watermark ("message" for send)
+	void setVolatile(const char *eventname, bool isVolatile);
+	//with SIOConfig::asyncDispatch, a received event not yet handled is
+	//replaced by a newer one of the same name
+	void setCoalesced(const char *eventname, bool isCoalesced);
+	bool isCoalesced(const std::string &eventname);
+	//received events SIOConfig::INBOUND_DROP_EVENTS may drop when the inbound queue is full
+	void setDroppable(const char *eventname, bool isDroppable);
+	bool isDroppable(const std::string &eventname);
+	//emits per second of this namespace and the burst allowed, instead of
+	//SIOConfig::rateLimit and rateBurst; 0 removes the limit
+	void setRateLimit(double rate, double burst = 0);
+	std::size_t throttledEmits();//delayed by the rate limit
+	std::size_t droppedEmits();//rejected by the rate limit, volatile included
   std::string getUri();
+	std::string getEndpoint();
+	//the server acknowledged the namespace, emits go out right away
+	bool isConnected();
+	SIOClientImpl *getSocket();
 	Poco::NotificationCenter* getNCenter();
 
 	typedef void (SIOEventTarget::*callback)(const void*, Array::Ptr&);
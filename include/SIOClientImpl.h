@@ -1,8 +1,12 @@
 #ifndef SIO_ClientImpl_DEFINED
 #define SIO_ClientImpl_DEFINED
 
+#include <atomic>
+#include <map>
 #include <string>
+#include <vector>
 
+#include "Poco/AutoPtr.h"
 #include "Poco/Net/HTTPClientSession.h"
 #include "Poco/Net/WebSocket.h"
 #include "Poco/Logger.h"
@@ -12,6 +16,9 @@
 #include "Poco/ThreadTarget.h"
 #include "Poco/RunnableAdapter.h"
 #include "Poco/URI.h"
+#include "Poco/Mutex.h"
+#include "Poco/Event.h"
+#include "Poco/Random.h"
 
 #include "Poco/JSON/Parser.h"
 
@@ -19,6 +26,21 @@
 #include "SIOEventRegistry.h"
 #include "SIOEventTarget.h"
 #include "SIOPacket.h"
+#include "SIOConfig.h"
+#include "SIOOutboundBuffer.h"
+#include "SIORttStats.h"
+#include "SIORateLimiter.h"
+#include "SIOSendQueue.h"
+#include "SIOInboundQueue.h"
+#include "SIOTrace.h"
+#include "SIOCapture.h"
+#include "SIOMetrics.h"
+#include "SIOLatency.h"
+#include "SIOInterceptor.h"
+
+class SIOClient;
+class SIODeflate;
+class SIOFrameWriter;
 
 using Poco::Net::HTTPClientSession;
 using Poco::Net::WebSocket;
@@ -33,50 +55,220 @@ using Poco::ThreadTarget;
 class SIOClientImpl: public Poco::Runnable
 {
 public:
+	//namespace state, emits wait in the offline buffer until CONNECTED
+	enum EndpointStatus
+	{
+		ENDPOINT_DISCONNECTED,
+		ENDPOINT_CONNECTING,//connect sent, waiting for the server to acknowledge it
+		ENDPOINT_CONNECTED
+	};
+
 	bool handshake();
 	bool openSocket();
 	bool init();
 
+	//reference counted like Poco::RefCountedObject, for Poco::AutoPtr
 	void release();
-	void addref();
+	void duplicate();
+	//a reference unless the count already dropped to zero, for lookups
+	//that may race with the last release
+	bool tryDuplicate();
 
 	static SIOClientImpl* connect(Poco::URI uri);
+	static SIOClientImpl* connect(Poco::URI uri, const SIOConfig &config);
 	void disconnect(std::string endpoint);
 	void connectToEndpoint(std::string endpoint);
 	void monitor();
 	virtual void run();
 	void heartbeat(Poco::Timer& timer);
+	void watchdog(Poco::Timer& timer);
 	bool receive();
-	void send(std::string endpoint, std::string s);
-	void send(SocketIOPacket *packet);
-	void emit(std::string endpoint, std::string eventname, std::string args);
-  void emit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args);
+	//decode a received text frame and dispatch it to the client of its endpoint
+	bool handleFrame(const char *data, std::size_t size);
+	//a socket without network for sio_replay: recorded frames are fed to
+	//replayFrame, what it would send is discarded. Registered and released
+	//like a connected one.
+	static SIOClientImpl* replay(Poco::URI uri, SocketIOPacket::SocketIOVersion version, const SIOConfig &config);
+	//a frame as received, through the same path as receive()
+	bool replayFrame(const char *data, std::size_t size, int flags);
+	//false when the message was neither sent nor buffered
+	bool send(std::string endpoint, std::string s, bool isVolatile = false);
+	//takes ownership of the packet
+	bool send(SocketIOPacket *packet);
+	//a non empty key makes the emit replace the unsent one of the same event and key
+	bool emit(std::string endpoint, std::string eventname, std::string args, bool isVolatile = false, std::string key = std::string());
+  bool emit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args, bool isVolatile = false, std::string key = std::string());
+	//same as emit but fails right away while the writer is above the high watermark
+	bool tryEmit(std::string endpoint, std::string eventname, std::string args, bool isVolatile = false);
+	bool tryEmit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args, bool isVolatile = false);
+	//bytes queued for the writer thread
+	std::size_t bufferedAmount();
 
 	std::string getUri();
+	EndpointStatus getEndpointStatus(const std::string &endpoint);
+	//copy of the ping round trip times of this connection (V10x)
+	SIORttStats getRttStats();
+	//heartbeats skipped by SIOConfig::heartbeatSuppression
+	std::size_t getSuppressedHeartbeats();
+	//overrides SIOConfig::rateLimit and rateBurst for one namespace
+	void setRateLimit(const std::string &endpoint, double rate, double burst);
+	//events waiting for the dispatch thread of SIOConfig::asyncDispatch, and their high marks
+	SIOInboundQueue::Stats getInboundStats();
+	//emits of the namespace delayed, and rejected or dropped, by its rate limit
+	void getRateCounters(const std::string &endpoint, std::size_t &throttled, std::size_t &dropped);
+	//adds the counters and gauges of this connection to a scrape of SIOMetrics
+	void collectMetrics(SIOMetricsSnapshot &snapshot);
 
 private:
 
 
 	SIOClientImpl();
-	SIOClientImpl(Poco::URI uri);
+	SIOClientImpl(Poco::URI uri, const SIOConfig &config);
 	~SIOClientImpl(void);
+
+	bool openSocket(Poco::Timestamp::TimeDiff retry);
+	void closeSocket();
+	void startHeartbeat();
+	void stopTimers();
+	//unblocks the receive thread, which then reconnects
+	void shutdownSocket();
+	//an application message went out, for heartbeat suppression
+	void messageSent();
+	//fire an event on every client of this socket
+	void fireAll(const char *name, Poco::JSON::Array::Ptr args);
+	//hand a received event to its client, now or through the dispatch thread
+	void dispatch(SIOClient *c, const std::string &uri, SocketIOPacket *packet, std::size_t size);
+	void dispatchAsync(SIOClient *c, const std::string &uri, SocketIOPacket *packet, std::size_t size);
+	//calls the hook of every interceptor of the config, check there are some first
+	void intercept(void (SIOInterceptor::*hook)(SIOPacketInfo &), SIOPacketInfo &info);
+	//dispatch thread of SIOConfig::asyncDispatch
+	void dispatchLoop();
+
+	//reconnect with backoff after the connection dropped, false when giving up
+	bool reconnect();
+	long reconnectDelay(int attempt);
+	//what a namespace needs to resume its session after a reconnection
+	struct EndpointState
+	{
+		EndpointState() : status(ENDPOINT_DISCONNECTED), recovered(false), next(0) {};
+		EndpointStatus status;
+		std::string pid;//private session id, empty when the server cannot recover state
+		bool recovered;//the last connect ack resumed the session, the server replays
+		std::string offset;//offset of the last event received
+		std::vector<std::string> recent;//ring of the last offsets
+		std::size_t next;
+		SIORateLimiter limiter;
+	};
+
+	//with _endpointsMutex held, created with the rate limit of the config
+	EndpointState &endpointState(const std::string &endpoint);
+	//takes up to wanted tokens from the rate limiter of the endpoint
+	std::size_t admit(const std::string &endpoint, std::size_t wanted);
+	//with _offlineMutex held and the endpoint connected: its rate queue, what
+	//was buffered while offline moved behind the frames it held back before
+	SIOOutboundBuffer &rateQueue(const std::string &endpoint);
+	//with _offlineMutex held, the pacing timer writes rate limited frames as tokens come in
+	void startPacing();
+	void pace(Poco::Timer& timer);
+
+	void setEndpointStatus(const std::string &endpoint, EndpointStatus status);
+	//the server gave the endpoint a private session id, its events carry offsets
+	bool hasPid(const std::string &endpoint);
+	//records the offset, true when the session was recovered and the offset
+	//already received (a replayed duplicate)
+	bool seenOffset(const std::string &endpoint, const std::string &offset);
+
+	//send a connect packet for every namespace registered on this socket
+	void rejoinEndpoints();
+	//write what was buffered for the endpoint while disconnected, once its connect is acknowledged
+	void flushOffline(const std::string &endpoint);
+
+	//all frames are queued for the writer thread, the strings are taken over
+	int sendFrame(const char *data, int size, SIOSendQueue::Lane lane = SIOSendQueue::LANE_CONTROL);
+	int sendFrame(std::string &prefix, std::string &payload, SIOSendQueue::Lane lane = SIOSendQueue::LANE_BULK, const std::string &key = std::string());
+	int sendFrames(std::vector<std::string> &frames, SIOSendQueue::Lane lane = SIOSendQueue::LANE_BULK);
+
+	//writer thread, control frames go out before queued bulk frames
+	void writeLoop();
+	void writeBatch(std::vector<SIOSendQueue::Frame> &batch);
+	//the client of a host:port + endpoint uri, when it uses this connection
+	Poco::AutoPtr<SIOClient> clientOf(const std::string &uri);
+	//counter and histograms of a received event, from _eventStats
+	struct EventStats
+	{
+		SIOCounter *received;
+		SIOEventLatency *latency;
+	};
+	EventStats eventStats(const std::string &endpoint, const std::string &event);
+	//trace, count, validate and decode a frame received at _frameReceived
+	bool processFrame(const char *data, std::size_t size, int flags);
+	//records a frame in the capture with its namespace, the packet header is
+	//in head when there is one
+	void capture(SIOCapture::Type type, int flags, const char *head, std::size_t headSize, const char *data, std::size_t size);
+	//with _sendMutex held, compressed when permessage-deflate is on.
+	//prefix and payload may be modified (masked in place) by the call
+	int writeFrame(std::string &prefix, std::string &payload);
+	//several whole frames in one go, the strings may be modified
+	int writeFrames(std::vector<std::string> &frames);
 	
 	std::string _sid;
 	int _heartbeat_timeout;
-	int _timeout;
+	int _timeout;//milliseconds, pong wait on 1.0.x and longest silence on 0.9.x
 	std::string _host;
 	int _port;
 	Poco::URI _uri;
-	bool _connected;
+	//shared by the application, receive, writer and timer threads
+	std::atomic<bool> _connected;
+	std::atomic<bool> _closing;//disconnect() was called, do not reconnect
+	std::atomic<int> _deadAfter;//ms of silence the watchdog gave up after, -1 if it did not
 	SocketIOPacket::SocketIOVersion _version;
+	SIOConfig _config;
 
 	HTTPClientSession *_session;
 	WebSocket *_ws;
+	SIODeflate *_deflate;
+	SIOFrameWriter *_frameWriter;
+	Poco::FastMutex _sendMutex;
+	SIOOutboundBuffer _offline;
+	std::map<std::string, SIOOutboundBuffer> _rateQueues;//emits held back by the rate limit, per endpoint
+	Poco::FastMutex _offlineMutex;//keeps buffered, held back and new emits of an endpoint in order
+	std::map<std::string, EndpointState> _endpoints;
+	Poco::FastMutex _endpointsMutex;
 	Timer *_heartbeatTimer;
+	Timer *_watchdogTimer;
+	Timer *_pacingTimer;
+	Poco::FastMutex _statsMutex;//guards the liveness and rtt members below
+	Poco::Timestamp _lastReceived;
+	Poco::Timestamp _frameReceived;//receive thread only, start of the event latencies
+	//receive thread only, the counters and histograms of the namespaces and
+	//names seen so far, without taking the metrics and SIOLatency locks for
+	//every event
+	std::map<std::pair<std::string, std::string>, EventStats> _eventStats;
+	Poco::Timestamp _pingSent;
+	Poco::Timestamp _lastMessageSent;
+	std::size_t _suppressedHeartbeats;
+	bool _pingPending;
+	SIORttStats _rtt;
 	Logger *_logger;
 	Thread _thread;
+	Poco::Event _closeEvent;
+	SIOSendQueue _sendQueue;
+	Thread _writerThread;
+	Poco::RunnableAdapter<SIOClientImpl> _writerAdapter;
+	SIOInboundQueue _inbound;
+	Thread _dispatchThread;
+	Poco::RunnableAdapter<SIOClientImpl> _dispatchAdapter;
+	Poco::Random _rnd;
+	SIOTracer *_tracer;
+	Poco::UInt32 _traceId;//connection id in the wire trace, the capture and the metrics
+	SIOCapture *_capture;
+	bool _replaying;//fed by replayFrame, there is no websocket
+	SIOConnectionMetrics _metrics;
 
-	int _refCount;
+	std::atomic<int> _refCount;
+	//deletes the socket from a pool thread, see release()
+	void reap();
+	Poco::RunnableAdapter<SIOClientImpl> _reapAdapter;
 	char *_buffer;
 	std::size_t _buffer_size;
 	
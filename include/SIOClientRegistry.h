@@ -1,33 +1,87 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <string>
+#include <vector>
 #include <iostream>
 
+#include "Poco/AutoPtr.h"
+#include "Poco/Mutex.h"
+#include "Poco/SingletonHolder.h"
+
 class SIOClient;
 class SIOClientImpl;
 
+//Clients (namespaces) and sockets by uri. Lookups come from every receive
+//thread while application threads connect and disconnect, so the maps are
+//sharded and read-mostly: each shard publishes an immutable map that readers
+//use without taking a lock. Writers copy the map under the shard mutex,
+//publish the copy and free the old one once no reader can still see it.
+//
+//The maps hold no references. Lookups hand clients and sockets out with a
+//reference held, taken while the map is still protected, so one disconnected
+//meanwhile lives until the caller lets go. An object unregisters itself
+//before it is freed and waits for the readers that could still see it; a
+//lookup racing with that finds no reference left to take and returns null.
 class SIOClientRegistry
 {
 private:
+	friend class Poco::SingletonHolder<SIOClientRegistry>;
+
 	SIOClientRegistry() {};
-	~SIOClientRegistry() {delete _inst;};
+	~SIOClientRegistry();
+
+	template <class T>
+	struct Shard
+	{
+		typedef std::map<std::string, T *> Map;
+
+		Shard() : map(new Map) {};
 
-	static SIOClientRegistry *_inst;
+		std::atomic<const Map *> map;
+		Poco::FastMutex writeMutex;
+		//replaced maps and the epoch they were replaced at
+		std::vector<std::pair<const Map *, unsigned long long> > retired;
+	};
 
-	std::map<std::string, SIOClient *> _clientMap;
-	std::map<std::string, SIOClientImpl *> _socketMap;
+	template <class T> static Poco::AutoPtr<T> find(Shard<T> &shard, const std::string &uri);
+	//get or add in one step under the shard mutex: the live value of the uri,
+	//or the given one once it is registered
+	template <class T> static Poco::AutoPtr<T> insert(Shard<T> &shard, const std::string &uri, T *value);
+	//expected NULL removes whatever the uri maps to
+	template <class T> static void remove(Shard<T> &shard, const std::string &uri, T *expected);
+	template <class T> static void publish(Shard<T> &shard, const typename Shard<T>::Map *map);
+	template <class T> static void reclaim(Shard<T> &shard);
+	template <class T> static void destroy(Shard<T> &shard);
+	static std::size_t shardOf(const std::string &uri);
+
+	enum {SHARDS = 16};
+
+	Shard<SIOClient> _clients[SHARDS];
+	Shard<SIOClientImpl> _sockets[SHARDS];
 
 public:
 	static SIOClientRegistry *instance();
 
-	SIOClient *getClient(std::string uri);
-	void addClient(SIOClient *client);
+	//null when the uri has no client
+	Poco::AutoPtr<SIOClient> getClient(std::string uri);
+	//the caller holds a reference to the client. Unless another thread
+	//registered the uri first, returns the client given; else the other one
+	Poco::AutoPtr<SIOClient> addClient(SIOClient *client);
 	void removeClient(std::string uri);
+	//only while the uri still maps to the client, and returns once no
+	//lookup can find it anymore: the client may be freed then
+	void removeClient(SIOClient *client);
+	//all clients (namespaces) using the given socket
+	void getClients(SIOClientImpl *socket, std::vector<Poco::AutoPtr<SIOClient> > &clients);
 
-	SIOClientImpl *getSocket(std::string uri);
-	void addSocket(SIOClientImpl *socket, std::string uri);
+	Poco::AutoPtr<SIOClientImpl> getSocket(std::string uri);
+	//same as addClient
+	Poco::AutoPtr<SIOClientImpl> addSocket(SIOClientImpl *socket, std::string uri);
 	void removeSocket(std::string uri);
-	
-};
+	//every uri the socket is registered under, returns once no lookup can
+	//find it anymore
+	void removeSocket(SIOClientImpl *socket);
 
+};
@@ -0,0 +1,178 @@
+#ifndef SIO_Config_INCLUDED
+#define SIO_Config_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+class SIOInterceptor;
+
+//Connection options, passed to SIOClient::connect when the physical socket
+//to the host is created. Namespaces joining an existing socket share its config.
+struct SIOConfig
+{
+	//how namespaces are spread over the connections to a host
+	enum Balancing
+	{
+		BALANCE_HASH,//by a hash of the namespace, the same namespace always uses the same connection
+		BALANCE_LEAST_LOADED//the connection with the fewest namespaces
+	};
+
+	//what the offline buffer does with a frame when it is full
+	enum BufferPolicy
+	{
+		BUFFER_DROP_OLDEST,//evict the oldest buffered frames to make room
+		BUFFER_DROP_NEWEST,//discard the new frame, emit still succeeds
+		BUFFER_REJECT//discard the new frame and fail the emit
+	};
+
+	//what the receive thread does with an event when the inbound queue is full
+	enum InboundPolicy
+	{
+		INBOUND_BLOCK,//wait for room, the server is slowed down by TCP flow control
+		INBOUND_DROP_OLDEST,//evict the oldest undelivered events
+		INBOUND_DROP_EVENTS,//evict the oldest droppable event, block when there is none
+		INBOUND_DISCONNECT//drop the event and close the connection
+	};
+
+	//what a namespace does with an emit over its rate limit
+	enum RatePolicy
+	{
+		RATE_DELAY,//hold it in the namespace's rate queue until tokens are available
+		RATE_REJECT//discard it and fail the emit
+	};
+
+	SIOConfig() :
+		deflate(false),
+		deflateNoContextTakeover(false),
+		deflateWindowBits(15),
+		deflateMemLevel(8),
+		deflateLevel(6),
+		deflateThreshold(256),
+		customFraming(false),
+		validateUTF8(true),
+		reconnection(true),
+		reconnectionAttempts(0),
+		reconnectionDelay(1000),
+		reconnectionDelayMax(30000),
+		offlineBufferMessages(1000),
+		offlineBufferBytes(1024 * 1024),
+		offlineBufferPolicy(BUFFER_DROP_OLDEST),
+		stateRecovery(false),
+		stateRecoveryWindow(64),
+		livenessCheck(true),
+		heartbeatSuppression(false),
+		connections(1),
+		balancing(BALANCE_HASH),
+		writeBatchBytes(64 * 1024),
+		highWatermark(1024 * 1024),
+		lowWatermark(256 * 1024),
+		sendQueueMaxBytes(16 * 1024 * 1024),
+		sendQueueTimeout(0),
+		asyncDispatch(false),
+		inboundMaxEvents(10000),
+		inboundMaxBytes(16 * 1024 * 1024),
+		inboundPolicy(INBOUND_BLOCK),
+		rateLimit(0),
+		rateBurst(0),
+		ratePolicy(RATE_DELAY),
+		rateQueueMessages(1000),
+		rateQueueBytes(1024 * 1024)
+	{};
+
+	//permessage-deflate (RFC 7692)
+	bool deflate;//offer the extension during the websocket upgrade
+	bool deflateNoContextTakeover;//ask both sides to reset their context after each message
+	int deflateWindowBits;//client_max_window_bits, 9..15
+	int deflateMemLevel;//zlib memLevel of the deflater, 1..9
+	int deflateLevel;//zlib compression level, 0..9
+	std::size_t deflateThreshold;//frames smaller than this many bytes are sent uncompressed
+
+	//write frames with SIOFrameWriter (SIMD masking, scatter/gather send)
+	//instead of WebSocket::sendFrame. Ignored for https and on Windows.
+	bool customFraming;
+
+	//drop received text frames that are not valid UTF-8
+	bool validateUTF8;
+
+	//reconnect when the connection drops, waiting a random delay between 0
+	//and min(reconnectionDelayMax, reconnectionDelay * 2^attempt) milliseconds
+	bool reconnection;
+	int reconnectionAttempts;//0 retries forever
+	long reconnectionDelay;
+	long reconnectionDelayMax;
+
+	//emits made while disconnected are kept, already encoded, and written in
+	//one batch once their namespace is connected again. 0 disables buffering.
+	std::size_t offlineBufferMessages;
+	std::size_t offlineBufferBytes;
+	BufferPolicy offlineBufferPolicy;
+
+	//V10x connection state recovery, off by default: it needs a socket.io v4
+	//server with connectionStateRecovery, older servers never send a private
+	//session id. When the server gives one, reconnections present it with the
+	//offset of the last event received so the server only replays what was
+	//missed. Once a session was recovered, events whose offset is among the
+	//last stateRecoveryWindow ones are dropped as replayed duplicates.
+	bool stateRecovery;
+	std::size_t stateRecoveryWindow;
+
+	//declare the connection dead when a ping got no pong within the
+	//pingTimeout of the 1.0.x handshake, or nothing was received for
+	//pingInterval + pingTimeout (the timeout alone on 0.9.x). The clients get
+	//a "ping_timeout" event on the receive thread once the socket is closed,
+	//then reconnection starts
+	bool livenessCheck;
+
+	//skip the heartbeat when messages were both sent and received since the
+	//previous one, the server counts any packet as a sign of life. Only on
+	//1.0.x, 0.9.x servers expect the heartbeats themselves.
+	bool heartbeatSuppression;
+
+	//physical connections opened to the host, each with its own receive
+	//thread and send path. Namespaces are assigned to them by balancing.
+	int connections;
+	Balancing balancing;
+
+	//frames are written by a thread per connection, heartbeats, pongs and
+	//namespace connects before queued messages. Messages are written in
+	//batches of about this many bytes (never split) so that a control
+	//frame waits for at most one batch.
+	std::size_t writeBatchBytes;
+
+	//once this many bytes wait for the writer, tryEmit fails until they
+	//drained to lowWatermark and the clients got a "drain" event
+	std::size_t highWatermark;
+	std::size_t lowWatermark;
+	//hard cap on the bytes waiting for the writer: emit, send and emitLatest
+	//then return false right away. With sendQueueTimeout they first wait up
+	//to that many milliseconds for room, except on the socket's own threads
+	//(handlers, timers) which the writer may be waiting for.
+	std::size_t sendQueueMaxBytes;
+	long sendQueueTimeout;
+
+	//fire received events from a dispatch thread per connection instead of
+	//the receive thread, so slow handlers do not stall reading the socket.
+	//Needed for SIOClient::setCoalesced to have anything to coalesce.
+	bool asyncDispatch;
+	//with asyncDispatch, events received and not handled yet are bounded by
+	//count and by the size of their frames
+	std::size_t inboundMaxEvents;
+	std::size_t inboundMaxBytes;
+	InboundPolicy inboundPolicy;
+
+	//token bucket per namespace: at most rateLimit emits per second, with
+	//bursts of up to rateBurst (0 for one second worth). 0 disables it.
+	//Delayed emits wait in a queue of their namespace, apart from the
+	//offline buffer: once it holds rateQueueMessages or rateQueueBytes the
+	//emit fails. The caller never blocks. See SIOClient::setRateLimit.
+	double rateLimit;
+	double rateBurst;
+	RatePolicy ratePolicy;
+	std::size_t rateQueueMessages;
+	std::size_t rateQueueBytes;
+	//called around encoding and dispatching every packet, see SIOInterceptor.
+	//Not owned, they must outlive the connection.
+	std::vector<SIOInterceptor *> interceptors;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SIO_Deflate_INCLUDED
+#define SIO_Deflate_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "Poco/Mutex.h"
+
+#include "SIOConfig.h"
+
+//Process wide pool of zlib streams. A connection without context takeover
+//only borrows a stream for the duration of one message, so thousands of idle
+//connections share a handful of deflate/inflate states instead of each
+//keeping its own (~300 KB with the default window and memLevel).
+class SIODeflatePool
+{
+public:
+	SIODeflatePool();
+	~SIODeflatePool();
+
+	static SIODeflatePool *instance();
+
+	z_stream *acquireDeflater(int windowBits, int memLevel, int level);
+	void releaseDeflater(z_stream *strm, int windowBits, int memLevel, int level);
+
+	z_stream *acquireInflater(int windowBits);
+	void releaseInflater(z_stream *strm, int windowBits);
+
+	void setMaxIdle(std::size_t maxIdle);
+
+private:
+	typedef std::map<int, std::vector<z_stream *> > StreamMap;
+
+	StreamMap _deflaters;
+	StreamMap _inflaters;
+	std::size_t _maxIdle;//idle streams kept per parameter set
+	Poco::FastMutex _mutex;
+};
+
+//permessage-deflate state of one websocket connection
+class SIODeflate
+{
+public:
+	SIODeflate(const SIOConfig &config);
+	~SIODeflate();
+
+	//value of the Sec-WebSocket-Extensions request header
+	std::string offer() const;
+	//parse the Sec-WebSocket-Extensions response header, false if the
+	//server did not accept the extension or asked for parameters we cannot
+	//honour (client_max_window_bits=8)
+	bool accept(const std::string &response);
+
+	std::size_t threshold() const {return _threshold;};
+
+	bool compress(const char *data, std::size_t size, std::string &out);
+	bool decompress(const char *data, std::size_t size, std::string &out);
+
+private:
+	z_stream *deflater();
+	z_stream *inflater();
+	void doneDeflater(z_stream *strm);
+	void doneInflater(z_stream *strm);
+
+	bool _clientNoContextTakeover;
+	bool _serverNoContextTakeover;
+	int _clientWindowBits;
+	int _serverWindowBits;
+	int _memLevel;
+	int _level;
+	std::size_t _threshold;
+
+	//only held while the matching side keeps its context between messages
+	z_stream *_deflater;
+	z_stream *_inflater;
+};
+
+#endif
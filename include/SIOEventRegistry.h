@@ -15,6 +15,7 @@ using Poco::Delegate;
 typedef void (SIOEventTarget::*callback)(const void*, Array::Ptr&);
 
 class SIOClient;
+struct SIOEventLatency;
 
 class SIOEventRegistry
 {
@@ -28,5 +29,11 @@ public:
 
 private:
 
-	std::map<std::string, BasicEvent< Array::Ptr > *> mEventMap; //!< the map containing event names and handlers
+	struct Handlers
+	{
+		BasicEvent< Array::Ptr > *event;
+		SIOEventLatency *latency;//resolved on registration, not per fired event
+	};
+
+	std::map<std::string, Handlers> mEventMap; //!< the map containing event names and handlers
 };
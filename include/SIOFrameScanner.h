@@ -0,0 +1,37 @@
+#ifndef SIO_FrameScanner_INCLUDED
+#define SIO_FrameScanner_INCLUDED
+
+#include <cstddef>
+
+//Packet header of a received text frame. All pointers point into the frame,
+//nothing is copied and the payload is never split.
+struct SIOFrameHeader
+{
+	int type;//V09x packet type, V10x engine.io packet type
+	int subtype;//V10x socket.io packet type of engine.io messages, -1 otherwise
+	const char *id;//V09x message id, V10x ack id
+	std::size_t idSize;
+	const char *endpoint;
+	std::size_t endpointSize;
+	const char *payload;//everything after the header
+	std::size_t payloadSize;
+};
+
+//Vectorised (SSE2, scalar elsewhere) scanning of incoming text frames
+class SIOFrameScanner
+{
+public:
+	//first occurrence of c in [p, end), end if there is none
+	static const char *find(const char *p, const char *end, char c);
+
+	//type:id:endpoint:data
+	static bool parseV09x(const char *data, std::size_t size, SIOFrameHeader &out);
+	//<engine.io type>[<socket.io type>][/endpoint,][ack id]data
+	static bool parseV10x(const char *data, std::size_t size, SIOFrameHeader &out);
+
+	//true when data is well formed UTF-8 (no overlongs, surrogates or code
+	//points above U+10FFFF), ASCII runs are checked 16 bytes at a time
+	static bool validUTF8(const char *data, std::size_t size);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SIO_FrameWriter_INCLUDED
+#define SIO_FrameWriter_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "Poco/Random.h"
+#include "Poco/Net/StreamSocket.h"
+
+//Client side websocket framing that replaces WebSocket::sendFrame on plain
+//(non TLS) sockets. The payload is masked in place with SIMD XOR and the
+//frame header, packet prefix and payload go to the socket in one writev call
+//instead of being copied into a single buffer first.
+//
+//Not thread safe, the caller serialises writes.
+class SIOFrameWriter
+{
+public:
+	SIOFrameWriter(Poco::Net::StreamSocket &socket);
+
+	//false when the platform has no scatter/gather write, use WebSocket::sendFrame then
+	static bool supported();
+
+	//flags are the WebSocket::sendFrame flags (FIN, RSV and opcode bits).
+	//prefix and payload are masked in place and must not be reused afterwards.
+	int sendFrame(std::string &prefix, std::string &payload, int flags);
+	//several whole frames, as few system calls as possible
+	int sendFrames(std::vector<std::string> &frames, const std::vector<int> &flags);
+
+	//XOR data with the masking key, offset is the position of data[0] in the payload
+	static void mask(char *data, std::size_t size, const unsigned char key[4], std::size_t offset);
+
+	//writes the header of a masked frame, returns its length (at most 14)
+	static std::size_t writeHeader(unsigned char *header, int flags, Poco::UInt64 length, const unsigned char key[4]);
+
+private:
+	void newKey(unsigned char key[4]);
+
+	Poco::Net::StreamSocket &_socket;
+	Poco::Random _rnd;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SIO_Histogram_INCLUDED
+#define SIO_Histogram_INCLUDED
+
+#include <atomic>
+
+#include "Poco/Types.h"
+
+//Log-linear histogram of latencies in microseconds, in the spirit of
+//HdrHistogram: values below 64 have a bucket each, above that every power of
+//2 is split in 32 buckets, so a percentile is within about 3% of the recorded
+//value. Values up to 2^40 us (about 12 days) are kept, larger ones land in
+//the last bucket. Recording is a few relaxed atomic adds, any number of
+//threads can record into one histogram while another reads or merges it.
+class SIOHistogram
+{
+public:
+	enum
+	{
+		SUB_BITS = 5,
+		SUB_COUNT = 1 << SUB_BITS,
+		MAX_BITS = 40,
+		BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT
+	};
+
+	SIOHistogram();
+
+	void record(Poco::Int64 micros);
+	//adds the counts of other, which may be recorded into meanwhile
+	void merge(const SIOHistogram &other);
+	void reset();
+
+	Poco::UInt64 count() const {return _count.load(std::memory_order_relaxed);};
+	Poco::UInt64 sum() const {return _sum.load(std::memory_order_relaxed);};
+	Poco::UInt64 max() const {return _max.load(std::memory_order_relaxed);};
+	//percent in 0..100, e.g. 99.9 for the p999. 0 when empty
+	Poco::UInt64 percentile(double percent) const;
+
+	static int bucketOf(Poco::UInt64 value);
+	//highest value counted in the bucket
+	static Poco::UInt64 bucketValue(int bucket);
+
+private:
+	SIOHistogram(const SIOHistogram &);
+	SIOHistogram &operator=(const SIOHistogram &);
+
+	std::atomic<Poco::UInt64> _count;
+	std::atomic<Poco::UInt64> _sum;
+	std::atomic<Poco::UInt64> _max;
+	std::atomic<Poco::UInt64> _buckets[BUCKETS];
+};
+
+#endif
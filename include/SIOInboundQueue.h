@@ -0,0 +1,95 @@
+#ifndef SIO_InboundQueue_INCLUDED
+#define SIO_InboundQueue_INCLUDED
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "Poco/Condition.h"
+#include "Poco/Mutex.h"
+
+#include "SIOConfig.h"
+
+class SocketIOPacket;
+
+//Events received on a connection, waiting for its dispatch thread to fire
+//them so a slow handler does not hold up the receive thread. Bounded by
+//event count and bytes, SIOConfig::InboundPolicy says what happens when full.
+class SIOInboundQueue
+{
+public:
+	struct Event
+	{
+		Event() : packet(NULL), size(0) {};
+		std::string uri;//client the event is for
+		SocketIOPacket *packet;//NULL once dropped by INBOUND_DROP_EVENTS
+		std::size_t size;//bytes of the frame it was decoded from
+	};
+
+	enum Result
+	{
+		QUEUED,
+		COALESCED,//replaced an undelivered event
+		DROPPED,//the new event was dropped by the policy
+		OVER_BUDGET//full with INBOUND_DISCONNECT, the event was dropped
+	};
+
+	//snapshot of the budget, the high marks are the most ever queued
+	struct Stats
+	{
+		Stats() : events(0), bytes(0), highEvents(0), highBytes(0), dropped(0), coalesced(0), blocked(0) {};
+		std::size_t events;
+		std::size_t bytes;
+		std::size_t highEvents;
+		std::size_t highBytes;
+		std::size_t dropped;
+		std::size_t coalesced;
+		std::size_t blocked;//times the receive thread waited for room
+	};
+
+	SIOInboundQueue();
+	~SIOInboundQueue();
+
+	void setBudget(std::size_t maxEvents, std::size_t maxBytes, SIOConfig::InboundPolicy policy);
+
+	//takes ownership of the packet. An event with a key replaces the
+	//undelivered event queued with the same key, in its place. Droppable
+	//events are the ones INBOUND_DROP_EVENTS evicts. With INBOUND_BLOCK, and
+	//INBOUND_DROP_EVENTS when nothing is droppable, waits for room.
+	Result push(const std::string &uri, SocketIOPacket *packet, std::size_t size,
+		const std::string &key = std::string(), bool droppable = false);
+	//waits for the oldest event, false once closed and empty
+	bool pop(Event &event);
+
+	//pop returns false when the queue is empty instead of waiting, push no longer waits
+	void close();
+	//delete every undelivered event, returns how many
+	std::size_t clear();
+
+	std::size_t events();
+	std::size_t coalesced();//events replaced by a newer one with the same key
+	Stats stats();
+
+private:
+	bool full(std::size_t size) const;
+	void dropOldest();
+	//drop the oldest droppable event, false when there is none
+	bool dropDroppable();
+	void queued();
+
+	std::deque<Event> _events;//dropped events stay as holes until popped
+	std::deque<std::string> _keys;//key of each event, empty for most
+	std::map<std::string, unsigned long long> _keyed;//key to the sequence number of its event
+	std::deque<unsigned long long> _droppable;//sequence numbers of droppable events, oldest first
+	unsigned long long _head;//sequence number of the first event
+	std::size_t _maxEvents;
+	std::size_t _maxBytes;
+	SIOConfig::InboundPolicy _policy;
+	Stats _stats;
+	bool _closed;
+	Poco::FastMutex _mutex;
+	Poco::Condition _ready;
+	Poco::Condition _space;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SIO_Interceptor_INCLUDED
+#define SIO_Interceptor_INCLUDED
+
+#include <string>
+
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+
+class SocketIOPacket;
+
+//What an interceptor sees of an emitted or received packet. Nothing is
+//serialized for it: the packet holds the event and its arguments as they
+//are, bytes and elapsed are measured by the library anyway.
+struct SIOPacketInfo
+{
+	SIOPacketInfo() : connection(0), packet(NULL), bytes(0), elapsed(0) {};
+
+	Poco::UInt32 connection;//same id as in wire traces and metrics
+	std::string endpoint;
+	std::string event;
+	SocketIOPacket *packet;//NULL once the library no longer owns it
+	std::size_t bytes;//encoded size when sending, frame size when receiving
+	Poco::Timestamp::TimeDiff elapsed;//microseconds, see each hook
+};
+
+//Instrumentation around the packets of a connection, e.g. to sample
+//latencies, audit payload sizes or carry trace context in event arguments.
+//Interceptors are listed in SIOConfig::interceptors and called in that order
+//on the thread doing the work; a connection without any skips the hooks
+//entirely. They must outlive the connections they are given to.
+class SIOInterceptor
+{
+public:
+	virtual ~SIOInterceptor() {};
+
+	//emitting thread, before the packet is encoded, it may still be changed
+	virtual void beforeEncode(SIOPacketInfo &info) {};
+	//encoded and about to be queued or buffered, bytes and elapsed (encode time) are set
+	virtual void afterEncode(SIOPacketInfo &info) {};
+	//receive thread, decoded and about to be handed to its client, it may
+	//still be changed. elapsed is the time since the frame was received
+	virtual void beforeDispatch(SIOPacketInfo &info) {};
+	//handed to the client, packet is NULL. elapsed is the dispatch time, which
+	//includes the handlers unless SIOConfig::asyncDispatch is set
+	virtual void afterDispatch(SIOPacketInfo &info) {};
+};
+
+#endif
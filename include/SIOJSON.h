@@ -0,0 +1,67 @@
+#ifndef SIO_JSON_INCLUDED
+#define SIO_JSON_INCLUDED
+
+#include <string>
+
+#include "SIOPacket.h"
+
+//Internal JSON facade, every piece of JSON the client reads goes through here.
+//Two backends are compiled in; SIOJSON is the one selected at build time with
+//the SIO_JSON_SCANNER cmake option (Poco::JSON when off).
+
+struct SIOHandshake
+{
+	std::string sid;
+	int pingInterval;//milliseconds
+	int pingTimeout;//milliseconds
+};
+
+//Builds a Poco::JSON DOM for each payload
+class SIOJSONPoco
+{
+public:
+	static const char *name() {return "poco";};
+
+	//parse the engine.io open packet payload {"sid":..,"pingInterval":..,"pingTimeout":..}
+	static bool parseHandshake(const std::string &payload, SIOHandshake &out);
+	//parse an event payload and fill name and args of the packet
+	//V09x: {"name":"event","args":[...]}  V10x: ["event",...]
+	static bool parseEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet);
+	//parse the V10x namespace connect acknowledgement {"sid":..[,"pid":..]},
+	//pid is left empty when the server does not support state recovery
+	static bool parseConnect(const std::string &payload, std::string &sid, std::string &pid);
+	//offset appended by the server to V10x events: true when the last of at
+	//least two array elements is a JSON string
+	static bool parseOffset(const std::string &payload, std::string &offset);
+};
+
+//Single pass scanner. It finds the event name and the arguments without a
+//DOM and unescapes string arguments itself, but every other argument
+//(objects, arrays, numbers, booleans) is parsed with Poco::JSON so that
+//handlers get exactly what the Poco backend gives them: only events whose
+//arguments are all strings skip the DOM entirely.
+class SIOJSONScanner
+{
+public:
+	static const char *name() {return "scanner";};
+
+	static bool parseHandshake(const std::string &payload, SIOHandshake &out);
+	static bool parseEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet);
+	static bool parseConnect(const std::string &payload, std::string &sid, std::string &pid);
+	static bool parseOffset(const std::string &payload, std::string &offset);
+
+	//helpers shared by the parse functions, exposed for the benchmarks
+	static const char *skipWhitespace(const char *p, const char *end);
+	//returns the end of the value starting at p, NULL if it is malformed
+	static const char *skipValue(const char *p, const char *end);
+	//p points to the opening quote; returns the position after the closing one
+	static const char *readString(const char *p, const char *end, std::string &out);
+};
+
+#ifdef SIO_JSON_SCANNER
+typedef SIOJSONScanner SIOJSON;
+#else
+typedef SIOJSONPoco SIOJSON;
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SIO_Latency_INCLUDED
+#define SIO_Latency_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Poco/RWLock.h"
+#include "Poco/SingletonHolder.h"
+
+#include "SIOHistogram.h"
+
+class SIOMetricsSnapshot;
+
+//Where a received event spent its time, from receiveFrame returning to its
+//handlers being done.
+struct SIOEventLatency
+{
+	SIOHistogram decode;//frame received to packet handed to dispatch (receive thread)
+	SIOHistogram queue;//dispatch to SIONotificationHandler, the inbound queue with asyncDispatch
+	SIOHistogram handler;//the handlers registered with on(), in SIOEventRegistry::fireEvent
+	SIOHistogram total;//frame received to handlers done
+};
+
+//Process wide latency histograms by event name, every connection and
+//namespace records into the same ones. Names are kept forever, past
+//MAX_EVENTS distinct names the new ones share OTHER so a server sending
+//arbitrary names cannot grow it without bound.
+class SIOLatency
+{
+private:
+	friend class Poco::SingletonHolder<SIOLatency>;
+
+	SIOLatency() {};
+	~SIOLatency();
+
+	std::map<std::string, SIOEventLatency *> _events;
+	Poco::RWLock _lock;
+
+public:
+	enum Stage
+	{
+		DECODE,
+		QUEUE,
+		HANDLER,
+		TOTAL
+	};
+
+	enum {MAX_EVENTS = 256};
+	static const char *OTHER;
+
+	static SIOLatency *instance();
+
+	//histograms of the event, created on first use, never freed
+	SIOEventLatency *get(const std::string &name);
+
+	void names(std::vector<std::string> &names);
+	//adds what was recorded at the stage of the event into histogram, false
+	//for an unknown event
+	bool collect(const std::string &name, Stage stage, SIOHistogram &histogram);
+	void reset();
+
+	//p50, p99, p999, sum and count of every event and stage, as Prometheus summaries
+	void collectMetrics(SIOMetricsSnapshot &snapshot);
+};
+
+#endif
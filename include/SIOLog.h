@@ -0,0 +1,59 @@
+#ifndef SIO_Log_INCLUDED
+#define SIO_Log_INCLUDED
+
+#include <cstdio>
+#include <string>
+
+#include "Poco/Logger.h"
+
+//Logging for the library. Calls above SIO_LOG_LEVEL are compiled out, the
+//others check the logger level before their arguments are even evaluated,
+//so a discarded message costs no formatting nor string building.
+//
+//	SIO_LOG_DEBUG(_logger, "received [%s]", SIOLogPayload(data, size));
+
+#define SIO_LOG_LEVEL_NONE        0
+#define SIO_LOG_LEVEL_FATAL       1
+#define SIO_LOG_LEVEL_CRITICAL    2
+#define SIO_LOG_LEVEL_ERROR       3
+#define SIO_LOG_LEVEL_WARNING     4
+#define SIO_LOG_LEVEL_NOTICE      5
+#define SIO_LOG_LEVEL_INFORMATION 6
+#define SIO_LOG_LEVEL_DEBUG       7//a line per frame
+#define SIO_LOG_LEVEL_TRACE       8
+
+//the most verbose level compiled in, same numbers as Poco::Message::Priority
+#ifndef SIO_LOG_LEVEL
+#define SIO_LOG_LEVEL SIO_LOG_LEVEL_INFORMATION
+#endif
+
+//payloads longer than this are cut in log messages
+#ifndef SIO_LOG_PAYLOAD_MAX
+#define SIO_LOG_PAYLOAD_MAX 256
+#endif
+
+#define SIO_LOG(level, method, logger, ...) \
+	do { if(SIO_LOG_LEVEL >= (level) && (logger)->method()) (logger)->method(__VA_ARGS__); } while(0)
+
+#define SIO_LOG_ERROR(logger, ...)       SIO_LOG(SIO_LOG_LEVEL_ERROR, error, logger, __VA_ARGS__)
+#define SIO_LOG_WARNING(logger, ...)     SIO_LOG(SIO_LOG_LEVEL_WARNING, warning, logger, __VA_ARGS__)
+#define SIO_LOG_INFORMATION(logger, ...) SIO_LOG(SIO_LOG_LEVEL_INFORMATION, information, logger, __VA_ARGS__)
+#define SIO_LOG_DEBUG(logger, ...)       SIO_LOG(SIO_LOG_LEVEL_DEBUG, debug, logger, __VA_ARGS__)
+#define SIO_LOG_TRACE(logger, ...)       SIO_LOG(SIO_LOG_LEVEL_TRACE, trace, logger, __VA_ARGS__)
+
+//at most SIO_LOG_PAYLOAD_MAX bytes of a payload, with its full size when cut
+inline std::string SIOLogPayload(const char *data, std::size_t size)
+{
+	if(size <= SIO_LOG_PAYLOAD_MAX)
+		return std::string(data, size);
+	char suffix[48];
+	snprintf(suffix, sizeof(suffix), "... (%lu bytes)", (unsigned long)size);
+	return std::string(data, SIO_LOG_PAYLOAD_MAX) + suffix;
+}
+
+inline std::string SIOLogPayload(const std::string &payload)
+{
+	return SIOLogPayload(payload.data(), payload.size());
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef SIO_Metrics_INCLUDED
+#define SIO_Metrics_INCLUDED
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Poco/Mutex.h"
+#include "Poco/SingletonHolder.h"
+#include "Poco/Types.h"
+
+class SIOClientImpl;
+
+//Counter updated from the I/O threads, alone on its cache line so counters
+//bumped by different threads do not invalidate each other.
+struct SIOCounter
+{
+	SIOCounter() : value(0) {};
+
+	void add(Poco::UInt64 n) {value.fetch_add(n, std::memory_order_relaxed);};
+	Poco::UInt64 get() const {return value.load(std::memory_order_relaxed);};
+
+	std::atomic<Poco::UInt64> value;
+	char padding[64 - sizeof(std::atomic<Poco::UInt64>)];
+};
+
+//Emits of one namespace, count and encoded bytes
+struct SIOEmitCounter
+{
+	SIOCounter count;
+	SIOCounter bytes;
+};
+
+//Counters of one connection, all atomics. Events and emits per namespace
+//and name live in maps under a mutex since names are only known as they
+//arrive, but the map nodes never move: received events get their counter
+//looked up once by the receive thread, and emits find theirs through a
+//lock free index, the mutex is only taken by the first emit of a namespace.
+class SIOConnectionMetrics
+{
+public:
+	SIOConnectionMetrics();
+
+	SIOCounter framesIn;
+	SIOCounter framesOut;
+	SIOCounter bytesIn;//websocket payloads, after inflating
+	SIOCounter bytesOut;//websocket payloads, before compression
+	SIOCounter parseErrors;//frames or events that could not be decoded
+	SIOCounter reconnects;
+	SIOCounter decodeMicros;//receive thread, frame to packet
+	SIOCounter dispatchMicros;//receive thread, handing packets to clients (handlers included without asyncDispatch)
+	SIOCounter encodeMicros;//emitting threads, packet to frame
+
+	//created on first use, lives as long as the connection
+	SIOCounter *eventCounter(const std::string &endpoint, const std::string &name);
+	void countEmit(const std::string &endpoint, std::size_t bytes)
+	{
+		SIOEmitCounter *counter = emitCounter(endpoint);
+		counter->count.add(1);
+		counter->bytes.add(bytes);
+	};
+
+	//copies, keyed by namespace then event name
+	void events(std::map<std::pair<std::string, std::string>, Poco::UInt64> &events);
+	void emits(std::map<std::string, std::pair<Poco::UInt64, Poco::UInt64> > &emits);//count and bytes
+
+private:
+	typedef std::map<std::string, SIOEmitCounter> EmitMap;
+
+	SIOEmitCounter *emitCounter(const std::string &endpoint);
+
+	//open addressing over the first EMIT_SLOTS namespaces, filled under the
+	//mutex and read without it
+	static const std::size_t EMIT_SLOTS = 64;
+	std::atomic<EmitMap::value_type *> _emitSlots[EMIT_SLOTS];
+
+	Poco::FastMutex _mutex;
+	std::map<std::pair<std::string, std::string>, SIOCounter> _events;
+	EmitMap _emits;
+};
+
+//Samples gathered for one scrape, grouped by metric name in the order the
+//names were first added.
+class SIOMetricsSnapshot
+{
+public:
+	//labels without braces, e.g. host="localhost:3000",connection="1". The
+	//suffix goes after the name, for the _sum and _count of a summary
+	void add(const char *name, const char *type, const char *help, const std::string &labels, double value, const char *suffix = "");
+	std::string renderPrometheus() const;
+
+	//label value quoted for the text format
+	static std::string quote(const std::string &value);
+
+private:
+	struct Sample
+	{
+		std::string suffix;
+		std::string labels;
+		double value;
+	};
+
+	struct Family
+	{
+		std::string type;
+		std::string help;
+		std::vector<Sample> samples;
+	};
+
+	std::vector<std::string> _order;
+	std::map<std::string, Family> _families;
+};
+
+//Every live connection of the process, for scraping.
+class SIOMetrics
+{
+private:
+	friend class Poco::SingletonHolder<SIOMetrics>;
+
+	SIOMetrics() {};
+
+	std::vector<SIOClientImpl *> _sockets;
+	Poco::FastMutex _mutex;
+
+public:
+	static SIOMetrics *instance();
+
+	void addSocket(SIOClientImpl *socket);
+	//before the socket goes away, a scrape in progress is waited for
+	void removeSocket(SIOClientImpl *socket);
+
+	//Prometheus text exposition format (version 0.0.4) of all connections,
+	//followed by the event latencies of SIOLatency
+	std::string renderPrometheus();
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SIO_OutboundBuffer_INCLUDED
+#define SIO_OutboundBuffer_INCLUDED
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SIOConfig.h"
+
+//Encoded frames waiting for their namespace to be (re)connected, bounded
+//by message count and bytes. Not thread safe, SIOClientImpl guards it.
+class SIOOutboundBuffer
+{
+public:
+	SIOOutboundBuffer();
+
+	void setLimits(std::size_t maxMessages, std::size_t maxBytes, SIOConfig::BufferPolicy policy);
+
+	//false when the frame is rejected: buffering is disabled, the frame is
+	//larger than the whole buffer, or the buffer is full with BUFFER_REJECT.
+	//With BUFFER_DROP_NEWEST a frame that does not fit is counted as dropped.
+	//A frame with a key replaces the buffered frame with the same key.
+	bool push(const std::string &endpoint, const std::string &frame, const std::string &key = std::string());
+	//queue frames behind the buffered ones whatever the limits, for frames
+	//that were already bounded by another buffer
+	void append(const std::string &endpoint, std::vector<std::string> &frames);
+	//move up to max frames of an endpoint, oldest first, into frames
+	void take(const std::string &endpoint, std::vector<std::string> &frames, std::size_t max = (std::size_t)-1);
+	bool has(const std::string &endpoint) const;
+	std::size_t count(const std::string &endpoint) const;
+	//endpoints with buffered frames
+	void endpoints(std::vector<std::string> &endpoints) const;
+	void clear();
+
+	std::size_t messages() const {return _frames.size();};
+	std::size_t bytes() const {return _bytes;};
+	std::size_t dropped() const {return _dropped;};//evicted or discarded by the policy
+	std::size_t rejected() const {return _rejected;};
+	std::size_t coalesced() const {return _coalesced;};
+
+private:
+	struct Frame
+	{
+		std::string endpoint;
+		std::string data;
+		std::string key;
+	};
+
+	void dropOldest();
+
+	std::deque<Frame> _frames;
+	std::map<std::string, std::size_t> _perEndpoint;//buffered frames per endpoint
+	std::size_t _bytes;
+	std::size_t _maxMessages;
+	std::size_t _maxBytes;
+	SIOConfig::BufferPolicy _policy;
+	std::size_t _dropped;
+	std::size_t _rejected;
+	std::size_t _coalesced;
+};
+
+#endif
@@ -5,10 +5,12 @@
 #include <vector>
 #include "Poco/JSON/Array.h"
 #include "Poco/JSON/Object.h"
+#include "Poco/Timestamp.h"
 
 using Poco::JSON::Array;
 
 class SocketIOPacketV10x;
+struct SIOEventLatency;
 
 class SocketIOPacket
 {
@@ -25,6 +27,9 @@ public:
 	void initWithTypeIndex(int index);
 
 	std::string toString();
+	//same as toString, split between the packet header and the data so both
+	//can be written without being concatenated
+	virtual void encode(std::string &prefix, std::string &payload);
 	virtual int typeAsNumber();
 	std::string typeForIndex(int index);
 
@@ -32,6 +37,20 @@ public:
 	std::string getEndpoint(){return _endpoint;};
 	void setEvent(std::string event){_name = event;};
 	std::string getEvent(){return _name;};
+	std::string getType(){return _type;};
+	//volatile packets are dropped instead of buffered while disconnected
+	void setVolatile(bool isVolatile){_volatile = isVolatile;};
+	bool isVolatile(){return _volatile;};
+	//while unsent, the packet is replaced by a newer one of the same event and key
+	void setCoalesceKey(std::string key){_coalesceKey = key;};
+	std::string getCoalesceKey(){return _coalesceKey;};
+	//received packets: where to record their latency, when their frame was
+	//received and when they were dispatched (epoch microseconds)
+	void setLatency(SIOEventLatency *latency, Poco::Timestamp::TimeVal received, Poco::Timestamp::TimeVal dispatched)
+		{_latency = latency; _received = received; _dispatched = dispatched;};
+	SIOEventLatency *getLatency(){return _latency;};
+	Poco::Timestamp::TimeVal getReceived(){return _received;};
+	Poco::Timestamp::TimeVal getDispatched(){return _dispatched;};
 
 	void addData(std::string data);
 	void addData(Poco::JSON::Array::Ptr data);
@@ -50,6 +69,11 @@ protected:
 	std::string _type;//message type
 	std::string _separator;//for stringify the object
 	std::vector<std::string> _types;//types of messages
+	bool _volatile;
+	std::string _coalesceKey;
+	SIOEventLatency *_latency;
+	Poco::Timestamp::TimeVal _received;
+	Poco::Timestamp::TimeVal _dispatched;
 };
 
 class SocketIOPacketV10x : public SocketIOPacket
@@ -57,6 +81,8 @@ class SocketIOPacketV10x : public SocketIOPacket
 public:
 	SocketIOPacketV10x();
 	virtual ~SocketIOPacketV10x();
+	//<type>[/endpoint,][ack id][data]
+	void encode(std::string &prefix, std::string &payload);
 	int typeAsNumber();
 	std::string stringify();
 private:
@@ -0,0 +1,38 @@
+#ifndef SIO_RateLimiter_INCLUDED
+#define SIO_RateLimiter_INCLUDED
+
+#include <cstddef>
+
+#include "Poco/Timestamp.h"
+
+//Token bucket of a namespace: rate tokens per second, up to burst saved up.
+//Not thread safe, SIOClientImpl guards it.
+class SIORateLimiter
+{
+public:
+	SIORateLimiter();
+
+	//rate 0 disables the limiter, burst 0 allows one second worth of tokens
+	void setRate(double rate, double burst);
+	bool enabled() const {return _rate > 0;};
+
+	//takes up to wanted tokens, returns how many were available
+	std::size_t take(std::size_t wanted);
+
+	void countThrottled() {++_throttled;};
+	void countDropped() {++_dropped;};
+	std::size_t throttled() const {return _throttled;};//emits delayed until tokens were available
+	std::size_t dropped() const {return _dropped;};//emits rejected or volatile emits dropped
+
+private:
+	void refill();
+
+	double _rate;
+	double _burst;
+	double _tokens;
+	Poco::Timestamp _last;
+	std::size_t _throttled;
+	std::size_t _dropped;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SIO_RttStats_INCLUDED
+#define SIO_RttStats_INCLUDED
+
+#include <vector>
+
+#include "Poco/Timestamp.h"
+
+//Round trip times of the last samples (ping to pong), in microseconds.
+//Not thread safe, SIOClientImpl hands out copies.
+class SIORttStats
+{
+public:
+	SIORttStats(std::size_t capacity = 128);
+
+	void add(Poco::Timestamp::TimeDiff rtt);
+
+	std::size_t count() const {return _samples.size();};
+	Poco::Timestamp::TimeDiff last() const {return _last;};
+	//0 when there is no sample yet
+	Poco::Timestamp::TimeDiff min() const;
+	Poco::Timestamp::TimeDiff avg() const;
+	//percent in 0..100, e.g. 99 for the p99
+	Poco::Timestamp::TimeDiff percentile(double percent) const;
+
+private:
+	std::vector<Poco::Timestamp::TimeDiff> _samples;
+	std::size_t _capacity;
+	std::size_t _next;
+	Poco::Timestamp::TimeDiff _last;
+};
+
+#endif
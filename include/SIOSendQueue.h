@@ -0,0 +1,85 @@
+#ifndef SIO_SendQueue_INCLUDED
+#define SIO_SendQueue_INCLUDED
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Poco/Condition.h"
+#include "Poco/Mutex.h"
+
+//Frames waiting for the writer thread of a connection. Control frames
+//(heartbeats, pongs, namespace connects) always go out before the bulk
+//frames (application messages) queued so far.
+class SIOSendQueue
+{
+public:
+	enum Lane
+	{
+		LANE_CONTROL,
+		LANE_BULK
+	};
+
+	//one websocket message, sent as prefix + payload
+	struct Frame
+	{
+		std::string prefix;
+		std::string payload;
+	};
+
+	SIOSendQueue();
+
+	//prefix and payload are swapped into the queue. A bulk frame with a key
+	//replaces the unsent frame queued with the same key, in its place.
+	void push(Lane lane, std::string &prefix, std::string &payload, const std::string &key = std::string());
+	//whole frames, kept in order
+	void push(Lane lane, std::vector<std::string> &frames);
+
+	//waits for frames and moves them into batch: every queued control frame,
+	//then bulk frames up to maxBytes. Bulk frames are never split, the batch
+	//ends at a message boundary. The batch is only empty when the queue was
+	//cleared below the low watermark, for takeDrained. False once closed and empty.
+	bool pop(std::vector<Frame> &batch, std::size_t maxBytes);
+
+	//pop returns false when the queue is empty instead of waiting
+	void close();
+	//drop everything queued, returns the number of frames dropped. Counts as
+	//draining when the high watermark had been reached
+	std::size_t clear();
+
+	std::size_t bytes();//queued in both lanes
+	std::size_t frames();
+
+	//once bytes() reached high, takeDrained() is true once after it fell back to low
+	void setWatermarks(std::size_t high, std::size_t low);
+	bool aboveHigh();
+	bool takeDrained();
+
+	//hard cap on the queued bytes, past the high watermark
+	void setMaxBytes(std::size_t max);
+	//true once bytes() is below the hard cap, false after waiting for timeout
+	//milliseconds or once closed
+	bool waitForRoom(long timeout);
+
+	std::size_t coalesced();//frames replaced by a newer one with the same key
+
+private:
+	std::deque<Frame> _lanes[2];
+	std::deque<std::string> _keys;//key of each bulk frame, empty for most
+	std::map<std::string, unsigned long long> _keyed;//key to the sequence number of its bulk frame
+	unsigned long long _bulkHead;//sequence number of the first bulk frame
+	std::size_t _coalesced;
+	std::size_t _bytes;
+	bool _closed;
+	std::size_t _high;
+	std::size_t _low;
+	std::size_t _max;
+	bool _full;//reached the high watermark, waiting to drain to low
+	bool _drained;
+	Poco::FastMutex _mutex;
+	Poco::Condition _ready;
+	Poco::Condition _room;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SIO_Trace_INCLUDED
+#define SIO_Trace_INCLUDED
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+#include "Poco/Event.h"
+#include "Poco/RunnableAdapter.h"
+#include "Poco/SingletonHolder.h"
+#include "Poco/Thread.h"
+#include "Poco/Types.h"
+
+//bytes of each frame kept in a trace record, so that a record fills one
+//64 byte cache line: copying more doubled the cost of tracing a frame
+#define SIO_TRACE_PAYLOAD 44
+
+//One traced websocket frame. The trace file is a SIOTraceHeader followed
+//by these records as they are in memory (little endian on every platform
+//the library is built for), read back by src/tools/sio_trace_decode.
+struct SIOTraceRecord
+{
+	Poco::UInt64 timestamp;//microseconds since the epoch, from the coarse clock on Linux (a few ms resolution)
+	Poco::UInt32 connection;//SIOTracer::nextConnection() of the socket
+	Poco::UInt32 length;//full length of the frame payload
+	Poco::UInt8 direction;//SIOTracer::Direction
+	Poco::UInt8 flags;//first byte of the frame: FIN, RSV and opcode
+	Poco::UInt16 size;//bytes of the payload kept in data
+	char data[SIO_TRACE_PAYLOAD];
+};
+
+struct SIOTraceHeader
+{
+	char magic[8];//"SIOTRACE"
+	Poco::UInt32 version;
+	Poco::UInt32 recordSize;
+};
+
+//Process wide wire tracer. Frames are copied into a fixed size lock free ring
+//by the receive and writer threads and written to the trace file by a
+//background thread, nothing is formatted on the I/O path. When the ring is
+//full the frame is counted as dropped instead of waiting for the file.
+class SIOTracer
+{
+private:
+	friend class Poco::SingletonHolder<SIOTracer>;
+
+	SIOTracer();
+	~SIOTracer();
+
+	struct Slot
+	{
+		std::atomic<Poco::UInt64> sequence;
+		SIOTraceRecord record;
+	};
+
+	void flushLoop();
+	//write the records ready in the ring, returns how many
+	std::size_t drain();
+
+	Slot *_slots;
+	std::size_t _capacity;
+	std::atomic<Poco::UInt64> _enqueue;
+	char _padding[64];//producers and the flush thread do not share a cache line
+	Poco::UInt64 _dequeue;//only the flush thread dequeues
+	std::atomic<bool> _enabled;
+	std::atomic<Poco::UInt64> _dropped;
+	std::atomic<Poco::UInt32> _connections;
+	FILE *_file;
+	Poco::Event _stop;
+	Poco::Thread _thread;
+	Poco::RunnableAdapter<SIOTracer> _flushAdapter;
+
+public:
+	enum Direction
+	{
+		IN,
+		OUT
+	};
+
+	static SIOTracer *instance();
+
+	//start tracing every connection into the file, the ring holds capacity
+	//records (rounded up to a power of 2). The ring is allocated on the first
+	//start and kept, later starts reuse it.
+	bool start(const std::string &path, std::size_t capacity = 65536);
+	//write what is left in the ring and close the file
+	void stop();
+
+	//acquire: a thread that sees tracing on also sees the ring start() set up
+	//before turning it on. A plain load on x86, the I/O path pays nothing more.
+	bool enabled() const {return _enabled.load(std::memory_order_acquire);};
+
+	//frame made of head followed by data, head may be empty
+	void record(Poco::UInt32 connection, Direction direction, int flags,
+		const char *head, std::size_t headSize, const char *data, std::size_t size);
+
+	//id of a new connection in the trace
+	Poco::UInt32 nextConnection() {return ++_connections;};
+	//frames lost because the ring was full
+	Poco::UInt64 dropped() const {return _dropped.load();};
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "SIOCapture.h"
+
+#include <cstring>
+
+#include "Poco/Timestamp.h"
+
+namespace
+{
+	static Poco::SingletonHolder<SIOCapture> sh;
+
+	//stdio buffer of the capture file
+	static const std::size_t FILE_BUFFER = 1024 * 1024;
+}
+
+SIOCapture *SIOCapture::instance()
+{
+	return sh.get();
+}
+
+SIOCapture::SIOCapture() :
+	_enabled(false),
+	_file(NULL)
+{
+}
+
+SIOCapture::~SIOCapture()
+{
+	stop();
+}
+
+bool SIOCapture::start(const std::string &path)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if(_file)
+		return false;
+	_file = fopen(path.c_str(), "wb");
+	if(!_file)
+		return false;
+	setvbuf(_file, NULL, _IOFBF, FILE_BUFFER);
+
+	SIOCaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SIOCAPTR", 8);
+	header.version = 2;
+	header.recordSize = sizeof(SIOCaptureRecord);
+	fwrite(&header, sizeof(header), 1, _file);
+
+	_endpoints.clear();
+	_enabled.store(true);
+	return true;
+}
+
+void SIOCapture::stop()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if(!_file)
+		return;
+	_enabled.store(false);
+	fclose(_file);
+	_file = NULL;
+}
+
+void SIOCapture::record(Poco::UInt32 connection, Type type, int flags, const char *endpoint, std::size_t endpointSize,
+	const char *head, std::size_t headSize, const char *data, std::size_t size)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	//stopped since enabled() was checked
+	if(!_file)
+		return;
+
+	Poco::UInt16 id = NO_ENDPOINT;
+	if(endpoint)
+	{
+		std::string name(endpoint, endpointSize);
+		std::map<std::string, Poco::UInt16>::iterator it = _endpoints.find(name);
+		if(it != _endpoints.end())
+			id = it->second;
+		else if(_endpoints.size() + 1 < MAX_ENDPOINTS)
+		{
+			id = (Poco::UInt16)(_endpoints.size() + 1);
+			_endpoints[name] = id;
+			write(connection, ENDPOINT, 0, id, NULL, 0, name.data(), name.size());
+		}
+	}
+	write(connection, type, flags, id, head, headSize, data, size);
+}
+
+void SIOCapture::write(Poco::UInt32 connection, Type type, int flags, Poco::UInt16 endpoint,
+	const char *head, std::size_t headSize, const char *data, std::size_t size)
+{
+	SIOCaptureRecord r;
+	r.timestamp = Poco::Timestamp().epochMicroseconds();
+	r.connection = connection;
+	r.length = (Poco::UInt32)(headSize + size);
+	r.type = (Poco::UInt8)type;
+	r.flags = (Poco::UInt8)flags;
+	r.endpoint = endpoint;
+
+	fwrite(&r, sizeof(r), 1, _file);
+	if(headSize > 0)
+		fwrite(head, 1, headSize, _file);
+	if(size > 0)
+		fwrite(data, 1, size, _file);
+}
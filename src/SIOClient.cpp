@@ -1,14 +1,16 @@
 #include "SIOClient.h"
 #include "SIOClientRegistry.h"
 
+#include <sstream>
+
 #include "Poco/URI.h"
 
 using Poco::URI;
 
 SIOClient::SIOClient(std::string uri, std::string endpoint, SIOClientImpl *impl)
-	: _uri(uri), _endpoint(endpoint), _socket(impl)
+	: _refCount(1), _uri(uri), _endpoint(endpoint), _socket(impl)
 {
-	_socket->addref();
+	_socket->duplicate();
 
 	_nCenter = new NotificationCenter;
 	_sioHandler = new SIONotificationHandler(_nCenter);
@@ -21,18 +23,69 @@ SIOClient::~SIOClient() {
 	delete(_sioHandler);
 	delete(_nCenter);
 	delete(_registry);
-
-	SIOClientRegistry::instance()->removeClient(_uri);
 }
 
 SIOClient* SIOClient::connect(std::string uri) {
+	return connect(uri, SIOConfig());
+}
+
+//registry key of the index-th connection to a host, the first one keeps the plain host:port
+static std::string socketKey(const std::string &hostPort, int index)
+{
+	if(index == 0)
+		return hostPort;
+	std::stringstream ss;
+	ss << hostPort << "#" << index;
+	return ss.str();
+}
+
+//which of the connections to a host a namespace goes to
+static int pickConnection(const std::string &hostPort, const std::string &path, const SIOConfig &config)
+{
+	int count = config.connections > 1 ? config.connections : 1;
+	if(count == 1)
+		return 0;
+
+	if(config.balancing == SIOConfig::BALANCE_LEAST_LOADED)
+	{
+		int best = 0;
+		std::size_t bestLoad = 0;
+		for(int i = 0; i < count; ++i)
+		{
+			Poco::AutoPtr<SIOClientImpl> impl = SIOClientRegistry::instance()->getSocket(socketKey(hostPort, i));
+			if(!impl)
+				return i;//not opened yet, nothing can be less loaded
+			std::vector<Poco::AutoPtr<SIOClient> > clients;
+			SIOClientRegistry::instance()->getClients(impl, clients);
+			if(i == 0 || clients.size() < bestLoad)
+			{
+				best = i;
+				bestLoad = clients.size();
+			}
+		}
+		return best;
+	}
+
+	//FNV-1a
+	unsigned int h = 2166136261u;
+	for(std::size_t i = 0; i < path.size(); ++i)
+	{
+		h ^= (unsigned char)path[i];
+		h *= 16777619u;
+	}
+	return (int)(h % count);
+}
+
+SIOClient* SIOClient::connect(std::string uri, const SIOConfig &config) {
 
 	//check if connection to endpoint exists 
 	URI tmp_uri(uri);
+	//the default namespace is registered without its slash
+	std::string path = tmp_uri.getPath() == "/" ? "" : tmp_uri.getPath();
 	std::stringstream ss;
-	ss << tmp_uri.getHost() << ":" << tmp_uri.getPort() << tmp_uri.getPath();
+	ss << tmp_uri.getHost() << ":" << tmp_uri.getPort() << path;
 	std::string fullpath = ss.str();
-	SIOClient *c = SIOClientRegistry::instance()->getClient(fullpath);
+	Poco::AutoPtr<SIOClient> c = SIOClientRegistry::instance()->getClient(fullpath);
 
 	if(!c)
 	{
@@ -40,36 +93,64 @@ SIOClient* SIOClient::connect(std::string uri) {
 		ss.str("");
 		ss.clear();
 		ss << tmp_uri.getHost() << ":" << tmp_uri.getPort();
-		std::string spath = ss.str();
-		SIOClientImpl *impl = SIOClientRegistry::instance()->getSocket(spath);
+		std::string spath = socketKey(ss.str(), pickConnection(ss.str(), path, config));
+		Poco::AutoPtr<SIOClientImpl> impl = SIOClientRegistry::instance()->getSocket(spath);
 
 		if(!impl)
 		{
-			impl = SIOClientImpl::connect(tmp_uri);
+			Poco::AutoPtr<SIOClientImpl> created(SIOClientImpl::connect(tmp_uri, config), true);
 
-			if (!impl) return NULL; //connect failed
+			if (!created) return NULL; //connect failed
 
-			SIOClientRegistry::instance()->addSocket(impl, spath);
-			
+			//a thread connecting to the same host meanwhile may have registered
+			//its socket first, ours is then closed when created lets go of it
+			impl = SIOClientRegistry::instance()->addSocket(created, spath);
 		} 
-		
-		if(tmp_uri.getPath() != "") {
-			impl->connectToEndpoint(tmp_uri.getPath());
+
+		SIOClient *created = new SIOClient(fullpath, path, impl);
+		c = SIOClientRegistry::instance()->addClient(created);
+		if(c != created)
+		{
+			//same for the namespace, the other client is used
+			created->release();
+			return c;
 		}
 
-		c = new SIOClient(fullpath, tmp_uri.getPath(), impl);
-		SIOClientRegistry::instance()->addClient(c);
-		
+		if(path != "") {
+			impl->connectToEndpoint(path);
+		}
 	}
 
 	//TODO: add method to handle force new connection
+	//the reference of c goes, the one the client was created with is the caller's
 	return c;
 
 }
 
 void SIOClient::disconnect() {
 	_socket->disconnect(_endpoint);
-	delete this;
+	//receive threads stop finding the client, those still using it hold a
+	//reference and the last one deletes it
+	SIOClientRegistry::instance()->removeClient(this);
+	release();
+}
+
+void SIOClient::duplicate() {
+	_refCount++;
+}
+
+void SIOClient::release() {
+	if(--_refCount == 0) delete this;
+}
+
+bool SIOClient::tryDuplicate() {
+	int count = _refCount.load();
+	while(count > 0)
+	{
+		if(_refCount.compare_exchange_weak(count, count + 1))
+			return true;
+	}
+	return false;
 }
 
 std::string SIOClient::getUri()
@@ -77,6 +158,21 @@ std::string SIOClient::getUri()
 	return _uri;
 }
 
+std::string SIOClient::getEndpoint()
+{
+	return _endpoint;
+}
+
+bool SIOClient::isConnected()
+{
+	return _socket->getEndpointStatus(_endpoint) == SIOClientImpl::ENDPOINT_CONNECTED;
+}
+
+SIOClientImpl *SIOClient::getSocket()
+{
+	return _socket;
+}
+
 NotificationCenter* SIOClient::getNCenter()
 {
 	return _nCenter;
@@ -92,18 +188,100 @@ void SIOClient::fireEvent(const char * name, Array::Ptr args)
 	_registry->fireEvent(this, name, args);
 }
 
-void SIOClient::send(std::string s)
+void SIOClient::setVolatile(const char *eventname, bool isVolatile)
 {
-	_socket->send(_endpoint, s);
+	if(isVolatile)
+		_volatileEvents.insert(eventname);
+	else
+		_volatileEvents.erase(eventname);
 }
 
-void SIOClient::emit(std::string eventname, Poco::JSON::Object::Ptr args)
+void SIOClient::setCoalesced(const char *eventname, bool isCoalesced)
 {
-  _socket->emit(_endpoint, eventname, args);
+	Poco::FastMutex::ScopedLock lock(_coalescedMutex);
+	if(isCoalesced)
+		_coalescedEvents.insert(eventname);
+	else
+		_coalescedEvents.erase(eventname);
+}
+
+bool SIOClient::isCoalesced(const std::string &eventname)
+{
+	Poco::FastMutex::ScopedLock lock(_coalescedMutex);
+	return _coalescedEvents.count(eventname) > 0;
+}
+
+void SIOClient::setDroppable(const char *eventname, bool isDroppable)
+{
+	Poco::FastMutex::ScopedLock lock(_coalescedMutex);
+	if(isDroppable)
+		_droppableEvents.insert(eventname);
+	else
+		_droppableEvents.erase(eventname);
+}
+
+bool SIOClient::isDroppable(const std::string &eventname)
+{
+	Poco::FastMutex::ScopedLock lock(_coalescedMutex);
+	return _droppableEvents.count(eventname) > 0;
+}
+
+void SIOClient::setRateLimit(double rate, double burst)
+{
+	_socket->setRateLimit(_endpoint, rate, burst);
+}
+
+std::size_t SIOClient::throttledEmits()
+{
+	std::size_t throttled, dropped;
+	_socket->getRateCounters(_endpoint, throttled, dropped);
+	return throttled;
+}
+
+std::size_t SIOClient::droppedEmits()
+{
+	std::size_t throttled, dropped;
+	_socket->getRateCounters(_endpoint, throttled, dropped);
+	return dropped;
+}
+
+bool SIOClient::send(std::string s)
+{
+	return _socket->send(_endpoint, s, _volatileEvents.count("message") > 0);
+}
+
+bool SIOClient::emit(std::string eventname, Poco::JSON::Object::Ptr args)
+{
+  return _socket->emit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0);
 
 } //void SIOClient::emit(std::string eventname, Poco::JSON::Object::Ptr args)
 
-void SIOClient::emit(std::string eventname, std::string args)
+bool SIOClient::emit(std::string eventname, std::string args)
+{
+	return _socket->emit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0);
+}
+
+bool SIOClient::tryEmit(std::string eventname, std::string args)
+{
+	return _socket->tryEmit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0);
+}
+
+bool SIOClient::tryEmit(std::string eventname, Poco::JSON::Object::Ptr args)
+{
+	return _socket->tryEmit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0);
+}
+
+bool SIOClient::emitLatest(std::string eventname, std::string key, std::string args)
+{
+	return _socket->emit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0, key);
+}
+
+bool SIOClient::emitLatest(std::string eventname, std::string key, Poco::JSON::Object::Ptr args)
+{
+	return _socket->emit(_endpoint, eventname, args, _volatileEvents.count(eventname) > 0, key);
+}
+
+std::size_t SIOClient::bufferedAmount()
 {
-	_socket->emit(_endpoint, eventname, args);
+	return _socket->bufferedAmount();
 }
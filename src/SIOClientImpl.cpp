@@ -10,6 +10,8 @@
 #include "Poco/Net/SocketAddress.h"
 #include "Poco/StreamCopier.h"
 #include "Poco/Format.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <limits>
@@ -17,15 +19,19 @@
 #include "Poco/String.h"
 #include "Poco/Timer.h"
 #include "Poco/RunnableAdapter.h"
+#include "Poco/ThreadPool.h"
+#include "Poco/Exception.h"
 #include "Poco/URI.h"
 
 #include "SIONotifications.h"
 #include "SIOClientRegistry.h"
 #include "SIOClient.h"
+#include "SIOJSON.h"
+#include "SIODeflate.h"
+#include "SIOFrameWriter.h"
+#include "SIOFrameScanner.h"
+#include "SIOLog.h"
 
-using Poco::JSON::Parser;
-using Poco::JSON::ParseHandler;
-using Poco::Dynamic::Var;
 using Poco::JSON::Array;
 using Poco::JSON::Object;
 
@@ -47,33 +53,80 @@ using Poco::Dynamic::Var;
 using Poco::Net::WebSocket;
 using Poco::URI;
 
-SIOClientImpl::SIOClientImpl()
+SIOClientImpl::SIOClientImpl() :
+	_writerAdapter(*this, &SIOClientImpl::writeLoop),
+	_dispatchAdapter(*this, &SIOClientImpl::dispatchLoop),
+	_reapAdapter(*this, &SIOClientImpl::reap)
 {
-	SIOClientImpl(URI("http://localhost:8080"));
+	SIOClientImpl(URI("http://localhost:8080"), SIOConfig());
 }
 
-SIOClientImpl::SIOClientImpl(URI uri) :
+SIOClientImpl::SIOClientImpl(URI uri, const SIOConfig &config) :
 	_buffer(NULL),
 	_buffer_size(0),
 	_port(uri.getPort()),
 	_host(uri.getHost()),
-	_refCount(0)
+	_connected(false),
+	_closing(false),
+	_deadAfter(-1),
+	_config(config),
+	_session(NULL),
+	_deflate(NULL),
+	_frameWriter(NULL),
+	_heartbeatTimer(NULL),
+	_watchdogTimer(NULL),
+	_pacingTimer(NULL),
+	_suppressedHeartbeats(0),
+	_pingPending(false),
+	_closeEvent(false),
+	_writerAdapter(*this, &SIOClientImpl::writeLoop),
+	_dispatchAdapter(*this, &SIOClientImpl::dispatchLoop),
+	_replaying(false),
+	_refCount(0),
+	_reapAdapter(*this, &SIOClientImpl::reap)
 {
 	_uri = uri;
 	_ws = NULL;	
+	_rnd.seed();
+	_tracer = SIOTracer::instance();
+	_traceId = _tracer->nextConnection();
+	_capture = SIOCapture::instance();
+	_offline.setLimits(config.offlineBufferMessages, config.offlineBufferBytes, config.offlineBufferPolicy);
+	_sendQueue.setWatermarks(config.highWatermark, config.lowWatermark);
+	_sendQueue.setMaxBytes(config.sendQueueMaxBytes);
+	_inbound.setBudget(config.inboundMaxEvents, config.inboundMaxBytes, config.inboundPolicy);
+}
 
+//the socket whose receive, writer, dispatch or timer thread this is
+static thread_local SIOClientImpl *socketThread = NULL;
+
+//the default namespace is "" or "/" depending on how the uri was written
+static std::string bufferKey(const std::string &endpoint)
+{
+	return endpoint == "/" ? std::string() : endpoint;
 }
 
 SIOClientImpl::~SIOClientImpl(void)
 {
-	
+	//before anything is freed: returns once no lookup can still find the socket
+	SIOClientRegistry::instance()->removeSocket(this);
+	SIOMetrics::instance()->removeSocket(this);
+	if(!_closing)
+		disconnect("");
 	_thread.join();
-	disconnect("");
+	if(_pacingTimer)
+		_pacingTimer->stop();
+	_sendQueue.close();
+	_writerThread.join();
+	//events already received are still delivered
+	_inbound.close();
+	_dispatchThread.join();
 
-	_ws->shutdown();
-	delete(_ws);
+	closeSocket();
 
 	delete(_heartbeatTimer);
+	delete(_watchdogTimer);
+	delete(_pacingTimer);
 	delete(_session);
 	if(_buffer)
 	{
@@ -81,11 +134,6 @@ SIOClientImpl::~SIOClientImpl(void)
 		_buffer = NULL;
 		_buffer_size = 0;
 	}
-
-	std::stringstream ss;
-	ss << _uri.getHost() << ":" << _uri.getPort() << _uri.getPath();
-	std::string uri = ss.str();
-	SIOClientRegistry::instance()->removeSocket(uri);
 }
 
 bool SIOClientImpl::init() {
@@ -93,7 +141,17 @@ bool SIOClientImpl::init() {
 
 	if(handshake()) 
 	{
-		if(openSocket()) return true;
+		if(openSocket())
+		{
+			//scraped from now on, a socket that failed is deleted unregistered
+			SIOMetrics::instance()->addSocket(this);
+			startHeartbeat();
+			_writerThread.start(_writerAdapter);
+			if(_config.asyncDispatch)
+				_dispatchThread.start(_dispatchAdapter);
+			_thread.start(*this);
+			return true;
+		}
 	}
 
 	return false;
@@ -106,8 +164,10 @@ bool SIOClientImpl::handshake()
 	if(_uri.getScheme() == "https")
 	{
 		const Context::Ptr context(new Context(Context::CLIENT_USE,"","","",Context::VERIFY_NONE));
+		delete _session;
 		_session = new HTTPSClientSession(_host, aport, context);
 	} else {
+		delete _session;
 		_session = new HTTPClientSession(_host, aport);
 	}
 	_session->setKeepAlive(false);
@@ -116,19 +176,19 @@ bool SIOClientImpl::handshake()
 	req.setContentType("text/plain");
 	req.setHost(_host);
 
-	_logger->information("Send Handshake Post request...:");
+	SIO_LOG_INFORMATION(_logger, "Send Handshake Post request...:");
 	HTTPResponse res;
 	std::string temp;
 
 	try {
 		_session->sendRequest(req);
 		std::istream& rs = _session->receiveResponse(res);
-		_logger->information("Receive Handshake Post request...");
+		SIO_LOG_INFORMATION(_logger, "Receive Handshake Post request...");
 		StreamCopier::copyToString(rs, temp);
 		if (res.getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
 		{
-			_logger->error("%s %s",res.getStatus(),res.getReason());
-			_logger->error("response: %s\n",temp);
+			SIO_LOG_ERROR(_logger, "%s %s",res.getStatus(),res.getReason());
+			SIO_LOG_ERROR(_logger, "response: %s\n",temp);
 			return false;
 		}
 
@@ -136,8 +196,8 @@ bool SIOClientImpl::handshake()
 		return false;
 	}
 
-	_logger->information("%s %s",res.getStatus(),res.getReason());
-	_logger->information("response: %s\n",temp);
+	SIO_LOG_INFORMATION(_logger, "%s %s",res.getStatus(),res.getReason());
+	SIO_LOG_INFORMATION(_logger, "response: %s\n",temp);
 
 	if(temp.at(temp.size()-1) == '}')
 	{
@@ -146,31 +206,33 @@ bool SIOClientImpl::handshake()
 		int a = temp.find('{');
 		temp = temp.substr(a,temp.size()-a);
 		temp = temp.substr(0,temp.find('}',temp.size()-5)+1);
-		ParseHandler::Ptr pHandler = new ParseHandler(false);
-		Parser parser(pHandler);
-		Var result = parser.parse(temp);
-		Object::Ptr msg = result.extract<Object::Ptr>();
+		SIOHandshake hs;
+		if(!SIOJSON::parseHandshake(temp, hs))
+		{
+			SIO_LOG_ERROR(_logger, "Invalid handshake: %s",temp);
+			return false;
+		}
 
-		_logger->information("session: %s",msg->get("sid").toString());
-		_logger->information("heartbeat: %s",msg->get("pingInterval").toString());
-		_logger->information("timeout: %s",msg->get("pingTimeout").toString());
+		SIO_LOG_INFORMATION(_logger, "session: %s",hs.sid);
+		SIO_LOG_INFORMATION(_logger, "heartbeat: %d",hs.pingInterval);
+		SIO_LOG_INFORMATION(_logger, "timeout: %d",hs.pingTimeout);
 
-		_sid = msg->get("sid").toString();
-		_heartbeat_timeout = atoi(msg->get("pingInterval").toString().c_str())/1000;
-		_timeout = atoi(msg->get("pingTimeout").toString().c_str())/1000;
+		_sid = hs.sid;
+		_heartbeat_timeout = hs.pingInterval/1000;
+		_timeout = hs.pingTimeout;
 	}
 	else
 	{
 		_version = SocketIOPacket::V09x;
 		StringTokenizer msg(temp, ":");
 		//3GYzE9md2Ig-lm3cf8Rv:60:60:websocket,htmlfile,xhr-polling,jsonp-polling
-		_logger->information("session: %s",msg[0]);
-		_logger->information("heartbeat: %s",msg[1]);
-		_logger->information("timeout: %s",msg[2]);
-		_logger->information("transports: %s",msg[3]);
+		SIO_LOG_INFORMATION(_logger, "session: %s",msg[0]);
+		SIO_LOG_INFORMATION(_logger, "heartbeat: %s",msg[1]);
+		SIO_LOG_INFORMATION(_logger, "timeout: %s",msg[2]);
+		SIO_LOG_INFORMATION(_logger, "transports: %s",msg[3]);
 		_sid = msg[0];
 		_heartbeat_timeout = atoi(msg[1].c_str());
-		_timeout = atoi(msg[2].c_str());
+		_timeout = atoi(msg[2].c_str())*1000;
 	}
 
 
@@ -179,7 +241,11 @@ bool SIOClientImpl::handshake()
 
 bool SIOClientImpl::openSocket()
 {
-	UInt16 aport = _port;
+	return openSocket(1000000);
+}
+
+bool SIOClientImpl::openSocket(Poco::Timestamp::TimeDiff retry)
+{
 	HTTPResponse res;
 	HTTPRequest req;
 	req.setMethod(HTTPRequest::HTTP_GET);
@@ -196,7 +262,13 @@ bool SIOClientImpl::openSocket()
 		}	break;
 	}
 
-	_logger->information("WebSocket To Create for %s",_sid);
+	if(_config.deflate)
+	{
+		_deflate = new SIODeflate(_config);
+		req.set("Sec-WebSocket-Extensions", _deflate->offer());
+	}
+
+	SIO_LOG_INFORMATION(_logger, "WebSocket To Create for %s",_sid);
 	Poco::Timestamp now;
 	now.update();
 	do
@@ -205,54 +277,662 @@ bool SIOClientImpl::openSocket()
 		{
 			_ws = new WebSocket(*_session, req, res);
 		}
-		catch(NetException& ne)
+		catch(Poco::Exception& ne)
 		{
 
-			_logger->warning("Exception when creating websocket %s : %s - %s",ne.displayText(),ne.code(),ne.what());
+			SIO_LOG_WARNING(_logger, "Exception when creating websocket %s : %s - %s",ne.displayText(),ne.code(),ne.what());
 			if(_ws)
 			{
 				delete _ws;
 				_ws = NULL;
 			}
-			Poco::Thread::sleep(100);
+			if(retry > 0)
+				Poco::Thread::sleep(100);
 		}
-	}while(_ws == NULL && now.elapsed() < 1000000);
+	}while(_ws == NULL && now.elapsed() < retry);
 	if(_ws == NULL)
 	{
-		_logger->error("Impossible to create websocket");
+		SIO_LOG_ERROR(_logger, "Impossible to create websocket");
 		return _connected;
 	}
 
+	if(_deflate)
+	{
+		std::string extensions = res.get("Sec-WebSocket-Extensions", "");
+		if(_deflate->accept(extensions))
+			SIO_LOG_INFORMATION(_logger, "permessage-deflate negotiated");
+		else if(extensions.find("permessage-deflate") != std::string::npos)
+		{
+			//the server compresses from now on, with parameters we cannot
+			//honour: RFC 7692 leaves failing the connection as the only way out
+			SIO_LOG_ERROR(_logger, "Unusable permessage-deflate parameters: %s",extensions);
+			closeSocket();
+			return false;
+		}
+		else
+		{
+			SIO_LOG_INFORMATION(_logger, "permessage-deflate declined by the server");
+			delete _deflate;
+			_deflate = NULL;
+		}
+	}
+
+	if(_config.customFraming)
+	{
+		if(SIOFrameWriter::supported() && _uri.getScheme() != "https")
+			_frameWriter = new SIOFrameWriter(*_ws);
+		else
+			SIO_LOG_INFORMATION(_logger, "Custom framing not available, using WebSocket::sendFrame");
+	}
+
 	if(_version == SocketIOPacket::V10x)
 	{
 		std::string s = "5";//That's a ping https://github.com/Automattic/engine.io-parser/blob/1b8e077b2218f4947a69f5ad18be2a512ed54e93/lib/index.js#L21
-		_ws->sendFrame(s.data(), s.size());
+		sendFrame(s.data(), s.size());
 	}
 
-	_logger->information("WebSocket Created and initialised");
+	SIO_LOG_INFORMATION(_logger, "WebSocket Created and initialised");
+
+	//the server joins the default namespace by itself and acknowledges it
+	setEndpointStatus("", ENDPOINT_CONNECTING);
+
+	{
+		Poco::FastMutex::ScopedLock lock(_statsMutex);
+		_lastReceived.update();
+		_pingPending = false;
+	}
+
+	if(_capture->enabled())
+	{
+		std::string open = std::string(_version == SocketIOPacket::V10x ? "1.0 " : "0.9 ") + _uri.toString();
+		_capture->record(_traceId, SIOCapture::OPEN, 0, NULL, 0, NULL, 0, open.data(), open.size());
+	}
 
 	_connected = true;//FIXME on 1.0.x the server acknowledge the connection
 
+	return _connected;
+
+}
+
+void SIOClientImpl::startHeartbeat()
+{
+	if(_heartbeatTimer)
+	{
+		_heartbeatTimer->stop();
+		delete _heartbeatTimer;
+	}
 	int hbInterval = this->_heartbeat_timeout*.75*1000;
 	_heartbeatTimer = new Timer(hbInterval, hbInterval);
 	TimerCallback<SIOClientImpl> heartbeat(*this, &SIOClientImpl::heartbeat);
 	_heartbeatTimer->start(heartbeat);
 
-	_thread.start(*this);
+	if(_watchdogTimer)
+	{
+		_watchdogTimer->stop();
+		delete _watchdogTimer;
+		_watchdogTimer = NULL;
+	}
+	if(_config.livenessCheck && _timeout > 0)
+	{
+		//check a few times per timeout so a dead link is noticed soon after it expires
+		int period = std::min(1000, std::max(100, _timeout/4));
+		_watchdogTimer = new Timer(period, period);
+		TimerCallback<SIOClientImpl> watchdog(*this, &SIOClientImpl::watchdog);
+		_watchdogTimer->start(watchdog);
+	}
+}
 
-	return _connected;
+void SIOClientImpl::stopTimers()
+{
+	if(_heartbeatTimer)
+		_heartbeatTimer->stop();
+	if(_watchdogTimer)
+		_watchdogTimer->stop();
+}
+
+void SIOClientImpl::watchdog(Poco::Timer& timer)
+{
+	socketThread = this;
+	Poco::Timestamp::TimeDiff idle, waited = -1;
+	{
+		Poco::FastMutex::ScopedLock lock(_statsMutex);
+		idle = _lastReceived.elapsed();
+		if(_pingPending)
+			waited = _pingSent.elapsed();
+	}
+	if(!_connected || _closing)
+		return;
+
+	Poco::Timestamp::TimeDiff timeout = (Poco::Timestamp::TimeDiff)_timeout*1000;
+	if(_version == SocketIOPacket::V10x)
+	{
+		//pingTimeout is the wait for the pong of our ping, a link that went
+		//quiet while no ping was pending still gets a whole ping interval on top
+		Poco::Timestamp::TimeDiff limit = (Poco::Timestamp::TimeDiff)_heartbeat_timeout*1000000 + timeout;
+		if(waited >= timeout)
+		{
+			SIO_LOG_WARNING(_logger, "No pong %d ms after the ping, the connection is dead",(int)(waited/1000));
+		}
+		else if(idle >= limit)
+		{
+			SIO_LOG_WARNING(_logger, "Nothing received for %d ms, the connection is dead",(int)(idle/1000));
+		}
+		else
+			return;
+	}
+	else
+	{
+		//the server sends the heartbeats, the timeout is the longest silence
+		if(idle < timeout)
+			return;
+		SIO_LOG_WARNING(_logger, "Nothing received for %d ms, the connection is dead",(int)(idle/1000));
+	}
+	//ping_timeout is fired by the receive thread: a handler that disconnects
+	//would stop this timer from its own callback, which never returns
+	_deadAfter = (int)(idle/1000);
+	_connected = false;
+	shutdownSocket();
+}
+
+void SIOClientImpl::shutdownSocket()
+{
+	Poco::FastMutex::ScopedLock lock(_sendMutex);
+	if(_ws)
+	{
+		try
+		{
+			_ws->shutdown();
+		}
+		catch(Poco::Exception &e)
+		{
+		}
+	}
+}
+
+void SIOClientImpl::fireAll(const char *name, Poco::JSON::Array::Ptr args)
+{
+	std::vector<Poco::AutoPtr<SIOClient> > clients;
+	SIOClientRegistry::instance()->getClients(this, clients);
+	for(std::size_t i = 0; i < clients.size(); ++i)
+		clients[i]->fireEvent(name, args);
+}
+
+void SIOClientImpl::dispatch(SIOClient *c, const std::string &uri, SocketIOPacket *packet, std::size_t size)
+{
+	std::string event = packet->getEvent();
+	EventStats stats = eventStats(bufferKey(packet->getEndpoint()), event);
+	stats.received->add(1);
+	Poco::Timestamp start;
+	SIOEventLatency *latency = stats.latency;
+	Poco::Timestamp::TimeDiff decode = start - _frameReceived;
+	latency->decode.record(decode);
+
+	bool intercepted = !_config.interceptors.empty();
+	SIOPacketInfo info;
+	if(intercepted)
+	{
+		info.connection = _traceId;
+		info.endpoint = packet->getEndpoint();
+		info.event = event;
+		info.packet = packet;
+		info.bytes = size;
+		info.elapsed = decode;
+		intercept(&SIOInterceptor::beforeDispatch, info);
+		start.update();
+	}
+
+	packet->setLatency(latency, _frameReceived.epochMicroseconds(), start.epochMicroseconds());
+	if(_config.asyncDispatch)
+		dispatchAsync(c, uri, packet, size);
+	else
+		c->getNCenter()->postNotification(new SIOEvent(c,packet));
+	Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+	_metrics.dispatchMicros.add(elapsed);
+
+	if(intercepted)
+	{
+		info.packet = NULL;
+		info.elapsed = elapsed;
+		intercept(&SIOInterceptor::afterDispatch, info);
+	}
+}
+
+Poco::AutoPtr<SIOClient> SIOClientImpl::clientOf(const std::string &uri)
+{
+	//with SIOConfig::connections the uri may name the client of another
+	//connection to the host: the default namespace is open on all of them
+	Poco::AutoPtr<SIOClient> c = SIOClientRegistry::instance()->getClient(uri);
+	if(c && c->getSocket() != this)
+		return Poco::AutoPtr<SIOClient>();
+	return c;
+}
+
+SIOClientImpl::EventStats SIOClientImpl::eventStats(const std::string &endpoint, const std::string &event)
+{
+	std::pair<std::string, std::string> key(endpoint, event);
+	std::map<std::pair<std::string, std::string>, EventStats>::iterator it = _eventStats.find(key);
+	if(it != _eventStats.end())
+		return it->second;
+	EventStats stats;
+	stats.received = _metrics.eventCounter(endpoint, event);
+	stats.latency = SIOLatency::instance()->get(event);
+	//a server making names up does not grow the cache, those are looked up every time
+	if(_eventStats.size() < SIOLatency::MAX_EVENTS)
+		_eventStats[key] = stats;
+	return stats;
+}
+
+void SIOClientImpl::intercept(void (SIOInterceptor::*hook)(SIOPacketInfo &), SIOPacketInfo &info)
+{
+	for(std::size_t i = 0; i < _config.interceptors.size(); ++i)
+		(_config.interceptors[i]->*hook)(info);
+}
+
+void SIOClientImpl::dispatchAsync(SIOClient *c, const std::string &uri, SocketIOPacket *packet, std::size_t size)
+{
+	std::string key;
+	if(c->isCoalesced(packet->getEvent()))
+		key = uri + "\n" + packet->getEvent();
+	bool droppable = c->isDroppable(packet->getEvent());
+	switch(_inbound.push(uri, packet, size, key, droppable))
+	{
+	case SIOInboundQueue::DROPPED:
+		SIO_LOG_WARNING(_logger, "Inbound queue full, dropped an event for %s",uri);
+		break;
+	case SIOInboundQueue::OVER_BUDGET:
+		SIO_LOG_ERROR(_logger, "Inbound queue full (%d events), closing the connection",(int)_inbound.events());
+		_connected = false;
+		shutdownSocket();
+		break;
+	default:
+		break;
+	}
+}
+
+SIOInboundQueue::Stats SIOClientImpl::getInboundStats()
+{
+	return _inbound.stats();
+}
+
+void SIOClientImpl::dispatchLoop()
+{
+	socketThread = this;
+	SIOInboundQueue::Event event;
+	while(_inbound.pop(event))
+	{
+		//the client may be gone since the event was queued
+		Poco::AutoPtr<SIOClient> c = clientOf(event.uri);
+		if(c)
+			c->getNCenter()->postNotification(new SIOEvent(c,event.packet));
+		else
+			delete event.packet;
+	}
+}
+
+SIORttStats SIOClientImpl::getRttStats()
+{
+	Poco::FastMutex::ScopedLock lock(_statsMutex);
+	return _rtt;
+}
+
+std::size_t SIOClientImpl::getSuppressedHeartbeats()
+{
+	Poco::FastMutex::ScopedLock lock(_statsMutex);
+	return _suppressedHeartbeats;
+}
+
+void SIOClientImpl::messageSent()
+{
+	if(!_config.heartbeatSuppression)
+		return;
+	Poco::FastMutex::ScopedLock lock(_statsMutex);
+	_lastMessageSent.update();
+}
+
+void SIOClientImpl::closeSocket()
+{
+	Poco::FastMutex::ScopedLock lock(_sendMutex);
+	delete _frameWriter;
+	_frameWriter = NULL;
+	if(_ws)
+	{
+		try
+		{
+			_ws->shutdown();
+		}
+		catch(Poco::Exception &e)
+		{
+		}
+		delete _ws;
+		_ws = NULL;
+	}
+	delete _deflate;
+	_deflate = NULL;
+}
+
+long SIOClientImpl::reconnectDelay(int attempt)
+{
+	//full jitter: uniform in [0, min(max, base * 2^attempt)]
+	long ceiling = _config.reconnectionDelayMax;
+	if(attempt < 30 && ((long)_config.reconnectionDelay << attempt) < ceiling)
+		ceiling = (long)_config.reconnectionDelay << attempt;
+	if(ceiling <= 0)
+		return 0;
+	return (long)_rnd.next((Poco::UInt32)ceiling + 1);
+}
+
+bool SIOClientImpl::reconnect()
+{
+	stopTimers();
+	closeSocket();
+	//pongs and messages queued for the dead connection
+	std::size_t stale = _sendQueue.clear();
+	if(stale > 0)
+		SIO_LOG_WARNING(_logger, "Dropped %d frames queued when the connection was lost",(int)stale);
+	{
+		Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+		for(std::map<std::string, EndpointState>::iterator it = _endpoints.begin(); it != _endpoints.end(); ++it)
+			it->second.status = ENDPOINT_DISCONNECTED;
+	}
+
+	for(int attempt = 0; _config.reconnectionAttempts == 0 || attempt < _config.reconnectionAttempts; ++attempt)
+	{
+		long delay = reconnectDelay(attempt);
+		SIO_LOG_INFORMATION(_logger, "Reconnecting in %ld ms (attempt %d)",delay,attempt+1);
+		if(_closeEvent.tryWait(delay))
+			return false;//disconnect() was called meanwhile
+
+		//the server may still know the session, skip the handshake then
+		bool reused = openSocket(0);
+		if(!reused)
+		{
+			closeSocket();
+			if(!handshake() || !openSocket(0))
+			{
+				closeSocket();
+				continue;
+			}
+		}
+		SIO_LOG_INFORMATION(_logger, "Reconnected (%s session %s)",std::string(reused ? "resumed" : "new"),_sid);
+		_metrics.reconnects.add(1);
+
+		startHeartbeat();
+		rejoinEndpoints();
+
+		Poco::JSON::Array::Ptr args = new Poco::JSON::Array();
+		args->add(attempt + 1);
+		fireAll("reconnect", args);
+		return true;
+	}
+
+	SIO_LOG_ERROR(_logger, "Giving up reconnecting to %s",_uri.toString());
+	return false;
+}
+
+void SIOClientImpl::rejoinEndpoints()
+{
+	//every namespace connect goes out back to back without waiting for the acks
+	std::vector<Poco::AutoPtr<SIOClient> > clients;
+	SIOClientRegistry::instance()->getClients(this, clients);
+
+	std::vector<std::string> frames;
+	for(std::size_t i = 0; i < clients.size(); ++i)
+	{
+		std::string endpoint = bufferKey(clients[i]->getEndpoint());
+
+		//namespaces with a private session id ask the server to recover it
+		if(_version == SocketIOPacket::V10x && _config.stateRecovery)
+		{
+			Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+			std::map<std::string, EndpointState>::iterator it = _endpoints.find(endpoint);
+			if(it != _endpoints.end() && !it->second.pid.empty())
+			{
+				Poco::JSON::Object auth;
+				auth.set("pid", it->second.pid);
+				auth.set("offset", it->second.offset);
+				std::stringstream ss;
+				ss << "40" << endpoint << (endpoint.empty() ? "" : ",");
+				auth.stringify(ss);
+				frames.push_back(ss.str());
+				it->second.status = ENDPOINT_CONNECTING;
+				continue;
+			}
+		}
+
+		if(endpoint == "")
+			continue;//the default namespace is joined with the socket
+		SocketIOPacket *packet = SocketIOPacket::createPacketWithType("connect",_version);
+		packet->setEndpoint(endpoint);
+		frames.push_back(packet->toString());
+		delete packet;
+		setEndpointStatus(endpoint, ENDPOINT_CONNECTING);
+	}
+
+	if(!frames.empty())
+	{
+		SIO_LOG_INFORMATION(_logger, "Rejoining %d namespaces",(int)frames.size());
+		sendFrames(frames, SIOSendQueue::LANE_CONTROL);
+	}
+}
+
+SIOClientImpl::EndpointStatus SIOClientImpl::getEndpointStatus(const std::string &endpoint)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	std::map<std::string, EndpointState>::iterator it = _endpoints.find(bufferKey(endpoint));
+	return it != _endpoints.end() ? it->second.status : ENDPOINT_DISCONNECTED;
+}
+
+void SIOClientImpl::setEndpointStatus(const std::string &endpoint, EndpointStatus status)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	endpointState(endpoint).status = status;
+}
+
+SIOClientImpl::EndpointState &SIOClientImpl::endpointState(const std::string &endpoint)
+{
+	std::string key = bufferKey(endpoint);
+	std::map<std::string, EndpointState>::iterator it = _endpoints.find(key);
+	if(it == _endpoints.end())
+	{
+		it = _endpoints.insert(std::make_pair(key, EndpointState())).first;
+		it->second.limiter.setRate(_config.rateLimit, _config.rateBurst);
+	}
+	return it->second;
+}
+
+std::size_t SIOClientImpl::admit(const std::string &endpoint, std::size_t wanted)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	return endpointState(endpoint).limiter.take(wanted);
+}
+
+void SIOClientImpl::setRateLimit(const std::string &endpoint, double rate, double burst)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	endpointState(endpoint).limiter.setRate(rate, burst);
+}
+
+void SIOClientImpl::getRateCounters(const std::string &endpoint, std::size_t &throttled, std::size_t &dropped)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	std::map<std::string, EndpointState>::iterator it = _endpoints.find(bufferKey(endpoint));
+	throttled = it != _endpoints.end() ? it->second.limiter.throttled() : 0;
+	dropped = it != _endpoints.end() ? it->second.limiter.dropped() : 0;
+}
+
+void SIOClientImpl::collectMetrics(SIOMetricsSnapshot &snapshot)
+{
+	std::stringstream host, id;
+	host << _uri.getHost() << ":" << _uri.getPort();
+	id << _traceId;
+	std::string labels = "host=" + SIOMetricsSnapshot::quote(host.str()) + ",connection=" + SIOMetricsSnapshot::quote(id.str());
+
+	snapshot.add("sio_connected", "gauge", "1 while the websocket is open.", labels, _connected ? 1 : 0);
+	snapshot.add("sio_frames_received_total", "counter", "Websocket frames received.", labels, (double)_metrics.framesIn.get());
+	snapshot.add("sio_frames_sent_total", "counter", "Websocket frames written.", labels, (double)_metrics.framesOut.get());
+	snapshot.add("sio_received_bytes_total", "counter", "Payload bytes received, after inflating.", labels, (double)_metrics.bytesIn.get());
+	snapshot.add("sio_sent_bytes_total", "counter", "Payload bytes written, before compression.", labels, (double)_metrics.bytesOut.get());
+	snapshot.add("sio_parse_errors_total", "counter", "Frames and events that could not be decoded.", labels, (double)_metrics.parseErrors.get());
+	snapshot.add("sio_reconnects_total", "counter", "Successful reconnections.", labels, (double)_metrics.reconnects.get());
+	snapshot.add("sio_decode_seconds_total", "counter", "Time spent decoding received frames.", labels, _metrics.decodeMicros.get() / 1e6);
+	snapshot.add("sio_dispatch_seconds_total", "counter", "Time spent handing received events to clients.", labels, _metrics.dispatchMicros.get() / 1e6);
+	snapshot.add("sio_encode_seconds_total", "counter", "Time spent encoding emitted packets.", labels, _metrics.encodeMicros.get() / 1e6);
+
+	snapshot.add("sio_send_queue_frames", "gauge", "Frames waiting for the writer thread.", labels, (double)_sendQueue.frames());
+	snapshot.add("sio_send_queue_bytes", "gauge", "Bytes waiting for the writer thread.", labels, (double)_sendQueue.bytes());
+	snapshot.add("sio_send_queue_coalesced_total", "counter", "Queued frames replaced by a newer one with the same key.", labels, (double)_sendQueue.coalesced());
+	SIOInboundQueue::Stats inbound = _inbound.stats();
+	snapshot.add("sio_inbound_queue_events", "gauge", "Events waiting for the dispatch thread.", labels, (double)inbound.events);
+	snapshot.add("sio_inbound_queue_bytes", "gauge", "Bytes of the events waiting for the dispatch thread.", labels, (double)inbound.bytes);
+	snapshot.add("sio_inbound_dropped_total", "counter", "Received events dropped by the inbound budget.", labels, (double)inbound.dropped);
+
+	SIORttStats rtt = getRttStats();
+	if(rtt.count() > 0)
+	{
+		snapshot.add("sio_heartbeat_rtt_seconds", "gauge", "Last ping round trip.", labels, rtt.last() / 1e6);
+		snapshot.add("sio_heartbeat_rtt_avg_seconds", "gauge", "Average ping round trip over the recent samples.", labels, rtt.avg() / 1e6);
+	}
+	snapshot.add("sio_heartbeats_suppressed_total", "counter", "Heartbeats skipped by heartbeat suppression.", labels, (double)getSuppressedHeartbeats());
+
+	//per namespace, the default one is "/"
+	std::map<std::pair<std::string, std::string>, Poco::UInt64> events;
+	_metrics.events(events);
+	for(std::map<std::pair<std::string, std::string>, Poco::UInt64>::iterator it = events.begin(); it != events.end(); ++it)
+	{
+		std::string ns = it->first.first.empty() ? "/" : it->first.first;
+		snapshot.add("sio_events_received_total", "counter", "Events dispatched, per namespace and name.",
+			labels + ",namespace=" + SIOMetricsSnapshot::quote(ns) + ",event=" + SIOMetricsSnapshot::quote(it->first.second), (double)it->second);
+	}
+
+	std::map<std::string, std::pair<Poco::UInt64, Poco::UInt64> > emits;
+	_metrics.emits(emits);
+	for(std::map<std::string, std::pair<Poco::UInt64, Poco::UInt64> >::iterator it = emits.begin(); it != emits.end(); ++it)
+	{
+		std::string ns = labels + ",namespace=" + SIOMetricsSnapshot::quote(it->first.empty() ? "/" : it->first);
+		snapshot.add("sio_emits_total", "counter", "Messages and events emitted by the application.", ns, (double)it->second.first);
+		snapshot.add("sio_emitted_bytes_total", "counter", "Encoded bytes of the emitted messages and events.", ns, (double)it->second.second);
+
+		std::size_t throttled, dropped;
+		getRateCounters(it->first, throttled, dropped);
+		snapshot.add("sio_emits_throttled_total", "counter", "Emits delayed by the rate limit.", ns, (double)throttled);
+		snapshot.add("sio_emits_rejected_total", "counter", "Emits rejected or dropped by the rate limit.", ns, (double)dropped);
+
+		Poco::FastMutex::ScopedLock lock(_offlineMutex);
+		snapshot.add("sio_offline_buffer_messages", "gauge", "Messages buffered until the namespace is connected.", ns, (double)_offline.count(it->first));
+		std::map<std::string, SIOOutboundBuffer>::iterator queue = _rateQueues.find(it->first);
+		snapshot.add("sio_rate_queue_messages", "gauge", "Messages held back by the rate limit.", ns,
+			(double)(queue != _rateQueues.end() ? queue->second.count(it->first) : 0));
+	}
+}
+
+void SIOClientImpl::startPacing()
+{
+	if(_pacingTimer)
+		return;
+	//runs until the socket is destroyed, it has nothing to do while no frame is held back
+	_pacingTimer = new Timer(20, 20);
+	TimerCallback<SIOClientImpl> pace(*this, &SIOClientImpl::pace);
+	_pacingTimer->start(pace);
+}
+
+void SIOClientImpl::pace(Poco::Timer& timer)
+{
+	socketThread = this;
+	if(!_connected || _closing)
+		return;
+	Poco::FastMutex::ScopedLock lock(_offlineMutex);
+	for(std::map<std::string, SIOOutboundBuffer>::iterator it = _rateQueues.begin(); it != _rateQueues.end(); ++it)
+	{
+		//held back for an endpoint not acknowledged again yet, flushOffline writes them
+		if(!it->second.has(it->first) || getEndpointStatus(it->first) != ENDPOINT_CONNECTED)
+			continue;
+		std::size_t tokens = admit(it->first, it->second.count(it->first));
+		if(tokens == 0)
+			continue;
+		std::vector<std::string> frames;
+		it->second.take(it->first, frames, tokens);
+		sendFrames(frames);
+		messageSent();
+	}
+}
+
+SIOOutboundBuffer &SIOClientImpl::rateQueue(const std::string &endpoint)
+{
+	std::map<std::string, SIOOutboundBuffer>::iterator it = _rateQueues.find(endpoint);
+	if(it == _rateQueues.end())
+	{
+		it = _rateQueues.insert(std::make_pair(endpoint, SIOOutboundBuffer())).first;
+		it->second.setLimits(_config.rateQueueMessages, _config.rateQueueBytes, SIOConfig::BUFFER_REJECT);
+	}
+	if(_offline.has(endpoint))
+	{
+		//bounded by the offline buffer already
+		std::vector<std::string> frames;
+		_offline.take(endpoint, frames);
+		SIO_LOG_INFORMATION(_logger, "Sending %d buffered messages to \"%s\"",(int)frames.size(),endpoint);
+		it->second.append(endpoint, frames);
+	}
+	return it->second;
+}
+
+bool SIOClientImpl::hasPid(const std::string &endpoint)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	std::map<std::string, EndpointState>::iterator it = _endpoints.find(bufferKey(endpoint));
+	return it != _endpoints.end() && !it->second.pid.empty();
+}
+
+bool SIOClientImpl::seenOffset(const std::string &endpoint, const std::string &offset)
+{
+	Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+	EndpointState &state = endpointState(endpoint);
+	//outside a replay a string last argument may just be repeated data
+	if(state.recovered && std::find(state.recent.begin(), state.recent.end(), offset) != state.recent.end())
+		return true;
+
+	if(state.recent.size() < _config.stateRecoveryWindow)
+		state.recent.push_back(offset);
+	else if(!state.recent.empty())
+	{
+		state.recent[state.next] = offset;
+		state.next = (state.next + 1) % state.recent.size();
+	}
+	state.offset = offset;
+	return false;
+}
 
+void SIOClientImpl::flushOffline(const std::string &endpoint)
+{
+	Poco::FastMutex::ScopedLock lock(_offlineMutex);
+	std::string key = bufferKey(endpoint);
+	SIOOutboundBuffer &queue = rateQueue(key);
+	std::vector<std::string> frames;
+	//what the rate limit does not let through now is left for the pacing timer
+	queue.take(key, frames, admit(key, queue.count(key)));
+	if(queue.has(key))
+		startPacing();
+	if(frames.empty())
+		return;
+
+	sendFrames(frames);
+	messageSent();
 }
 
 
 SIOClientImpl* SIOClientImpl::connect(URI uri)
 {
-	SIOClientImpl *s = new SIOClientImpl(uri);
+	return connect(uri, SIOConfig());
+}
+
+SIOClientImpl* SIOClientImpl::connect(URI uri, const SIOConfig &config)
+{
+	SIOClientImpl *s = new SIOClientImpl(uri, config);
 
 	if(s && s->init()) {
 		return s;
 	}
 
+	delete s;
 	return NULL;
 }
 
@@ -263,16 +943,52 @@ void SIOClientImpl::disconnect(std::string endpoint)
 		s = "0::" + endpoint;
 	else
 		s = "41" + endpoint;
-	_ws->sendFrame(s.data(), s.size());
 	if(endpoint == "")
 	{
-		_logger->information("Disconnect");
-		_heartbeatTimer->stop();
+		//no reconnection after an explicit disconnect
+		_closing = true;
+		_closeEvent.set();
+	}
+	{
+		//nobody is left to receive what the endpoint buffered
+		Poco::FastMutex::ScopedLock lock(_offlineMutex);
+		if(endpoint == "")
+		{
+			_offline.clear();
+			_rateQueues.clear();
+		}
+		else
+		{
+			std::vector<std::string> discarded;
+			_offline.take(bufferKey(endpoint), discarded);
+			_rateQueues.erase(bufferKey(endpoint));
+		}
+	}
+	if(endpoint != "")
+	{
+		Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+		_endpoints.erase(bufferKey(endpoint));
+	}
+	//behind the messages already emitted on the endpoint
+	if(_connected)
+		sendFrame(s.data(), s.size(), SIOSendQueue::LANE_BULK);
+	if(endpoint == "")
+	{
+		SIO_LOG_INFORMATION(_logger, "Disconnect");
+		stopTimers();
+		//let the writer send what is queued, a stuck socket is cut off by the shutdown below
+		_sendQueue.close();
 		_connected = false;
+		//from a drain handler the writer cannot wait for itself, it shuts
+		//the socket down once it has sent the queue
+		if(Poco::Thread::current() == &_writerThread)
+			return;
+		if(_writerThread.isRunning())
+			_writerThread.tryJoin(1000);
+
+		//unblocks the receive thread
+		shutdownSocket();
 	}
-
-	if(_version == SocketIOPacket::V10x)
-		_ws->shutdown();
 }
 
 void SIOClientImpl::connectToEndpoint(std::string endpoint)
@@ -288,7 +1004,8 @@ void SIOClientImpl::connectToEndpoint(std::string endpoint)
 //			break;
 //		}
 //	_ws->sendFrame(s.data(), s.size());
-	_logger->information("heartbeat called");
+	SIO_LOG_INFORMATION(_logger, "Connecting to endpoint %s",endpoint);
+	setEndpointStatus(endpoint, ENDPOINT_CONNECTING);
 	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("connect",_version);
 	packet->setEndpoint(endpoint);
 	this->send(packet);
@@ -297,7 +1014,25 @@ void SIOClientImpl::connectToEndpoint(std::string endpoint)
 
 void SIOClientImpl::heartbeat(Poco::Timer& timer)
 {
-	_logger->information("heartbeat called");
+	socketThread = this;
+	SIO_LOG_DEBUG(_logger, "heartbeat called");
+	if(_version == SocketIOPacket::V10x)
+	{
+		Poco::FastMutex::ScopedLock lock(_statsMutex);
+		if(_config.heartbeatSuppression)
+		{
+			//traffic both ways since the last tick proves the link to each side
+			Poco::Timestamp::TimeDiff interval = (Poco::Timestamp::TimeDiff)timer.getPeriodicInterval()*1000;
+			if(_lastMessageSent.elapsed() < interval && _lastReceived.elapsed() < interval)
+			{
+				++_suppressedHeartbeats;
+				return;
+			}
+		}
+		//the server answers the ping with a pong, that is the round trip
+		_pingSent.update();
+		_pingPending = true;
+	}
 	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("heartbeat",_version);
 	this->send(packet);
 //	std::string s;
@@ -315,65 +1050,358 @@ void SIOClientImpl::heartbeat(Poco::Timer& timer)
 
 void SIOClientImpl::run() {
 
+	socketThread = this;
 	monitor();
 
 }
  
 void SIOClientImpl::monitor() {
-	do 
+	do
 	{
-		receive();
-	} while (_connected);
+		do 
+		{
+			try
+			{
+				receive();
+			}
+			catch(Poco::Exception &e)
+			{
+				SIO_LOG_WARNING(_logger, "Connection lost: %s",e.displayText());
+				_connected = false;
+			}
+		} while (_connected);
+
+		int idle = _deadAfter.exchange(-1);
+		if(idle >= 0)
+		{
+			Poco::JSON::Array::Ptr args = new Poco::JSON::Array();
+			args->add(idle);
+			fireAll("ping_timeout", args);
+		}
+	} while (!_closing && _config.reconnection && reconnect());
 }
 
-void SIOClientImpl::send(std::string endpoint, std::string s)
+bool SIOClientImpl::send(std::string endpoint, std::string s, bool isVolatile)
 {
 	switch (_version) {
 		case SocketIOPacket::V09x:
 		{
-			_logger->information("Sending Message");
+			SIO_LOG_DEBUG(_logger, "Sending Message");
 			SocketIOPacket *packet = SocketIOPacket::createPacketWithType("message",_version);
 			packet->setEndpoint(endpoint);
 			packet->addData(s);
-			this->send(packet);
-		}	break;
+			packet->setVolatile(isVolatile);
+			return this->send(packet);
+		}
 		case SocketIOPacket::V10x:
-			this->emit(endpoint,"message",s);
-			break;
+			return this->emit(endpoint,"message",s,isVolatile);
 	}
+	return false;
 }
 
-void SIOClientImpl::emit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args)
+bool SIOClientImpl::emit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args, bool isVolatile, std::string key)
 {
-  _logger->information("Emitting event \"%s\"",eventname);
+  SIO_LOG_DEBUG(_logger, "Emitting event \"%s\"",eventname);
   SocketIOPacket *packet = SocketIOPacket::createPacketWithType("event",_version);
   packet->setEndpoint(endpoint);
   packet->setEvent(eventname);
   packet->addData(args);
-  this->send(packet);
+  packet->setVolatile(isVolatile);
+  packet->setCoalesceKey(key);
+  return this->send(packet);
 
 } //void SIOClientImpl::emit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args)
 
-void SIOClientImpl::emit(std::string endpoint, std::string eventname, std::string args)
+bool SIOClientImpl::emit(std::string endpoint, std::string eventname, std::string args, bool isVolatile, std::string key)
 {
-	_logger->information("Emitting event \"%s\"",eventname);
+	SIO_LOG_DEBUG(_logger, "Emitting event \"%s\"",eventname);
 	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("event",_version);
 	packet->setEndpoint(endpoint);
 	packet->setEvent(eventname);
 	packet->addData(args);
-	this->send(packet);
+	packet->setVolatile(isVolatile);
+	packet->setCoalesceKey(key);
+	return this->send(packet);
 }
 
-void SIOClientImpl::send(SocketIOPacket *packet)
+bool SIOClientImpl::tryEmit(std::string endpoint, std::string eventname, std::string args, bool isVolatile)
 {
-	std::string req = packet->toString();
-	if(_connected)
+	if(_sendQueue.aboveHigh())
+		return false;
+	return emit(endpoint, eventname, args, isVolatile);
+}
+
+bool SIOClientImpl::tryEmit(std::string endpoint, std::string eventname, Poco::JSON::Object::Ptr args, bool isVolatile)
+{
+	if(_sendQueue.aboveHigh())
+		return false;
+	return emit(endpoint, eventname, args, isVolatile);
+}
+
+std::size_t SIOClientImpl::bufferedAmount()
+{
+	return _sendQueue.bytes();
+}
+
+bool SIOClientImpl::send(SocketIOPacket *packet)
+{
+	std::string prefix, payload;
+	bool intercepted = !_config.interceptors.empty();
+	SIOPacketInfo info;
+	if(intercepted)
 	{
-		_logger->information("-->SEND:%s",req);
-		_ws->sendFrame(req.data(),req.size());
+		info.connection = _traceId;
+		info.endpoint = packet->getEndpoint();
+		info.event = packet->getEvent();
+		info.packet = packet;
+		intercept(&SIOInterceptor::beforeEncode, info);
 	}
-	else
-		_logger->warning("Cant send the message (%s) because disconnected",req);
+
+	Poco::Timestamp start;
+	packet->encode(prefix, payload);
+	Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+	_metrics.encodeMicros.add(elapsed);
+
+	if(intercepted)
+	{
+		info.bytes = prefix.size() + payload.size();
+		info.elapsed = elapsed;
+		intercept(&SIOInterceptor::afterEncode, info);
+	}
+	std::string type = packet->getType();
+	std::string key = bufferKey(packet->getEndpoint());
+	bool isVolatile = packet->isVolatile();
+	std::string coalesce;
+	if(!packet->getCoalesceKey().empty())
+		coalesce = key + "\n" + packet->getEvent() + "\n" + packet->getCoalesceKey();
+	delete packet;
+
+	//control packets are only meaningful on the current connection
+	if(type != "message" && type != "json" && type != "event" && type != "ack")
+	{
+		if(!_connected)
+		{
+			SIO_LOG_WARNING(_logger, "Cant send the message (%s) because disconnected",SIOLogPayload(prefix + payload));
+			return false;
+		}
+		SIO_LOG_DEBUG(_logger, "-->SEND:%s",SIOLogPayload(prefix + payload));
+		sendFrame(prefix, payload, SIOSendQueue::LANE_CONTROL);
+		return true;
+	}
+
+	_metrics.countEmit(key, prefix.size() + payload.size());
+
+	//volatile messages are only worth sending while they can go out right away
+	if(isVolatile && _sendQueue.aboveHigh())
+	{
+		SIO_LOG_DEBUG(_logger, "Dropping volatile message (%s) because the socket is congested",SIOLogPayload(prefix + payload));
+		return true;
+	}
+
+	//past the hard cap emits fail instead of growing the queue without bound,
+	//waiting for the writer only when asked to and never on a socket thread:
+	//a handler blocked there would keep the acks and pongs from being read.
+	//While disconnected the offline buffer has its own limits
+	if(_connected && !_sendQueue.waitForRoom(socketThread == this ? 0 : _config.sendQueueTimeout))
+	{
+		SIO_LOG_WARNING(_logger, "Rejecting message (%s), the send queue stayed full",SIOLogPayload(prefix + payload));
+		return false;
+	}
+
+	//until the endpoint is acknowledged new messages wait in the offline
+	//buffer, then behind those the rate limit held back
+	Poco::FastMutex::ScopedLock lock(_offlineMutex);
+	if(_connected && getEndpointStatus(key) == ENDPOINT_CONNECTED)
+	{
+		SIOOutboundBuffer &queue = rateQueue(key);
+		if(!queue.has(key) && admit(key, 1) == 1)
+		{
+			SIO_LOG_DEBUG(_logger, "-->SEND:%s",SIOLogPayload(prefix + payload));
+			sendFrame(prefix, payload, SIOSendQueue::LANE_BULK, coalesce);
+			messageSent();
+			return true;
+		}
+
+		//over the rate limit, or behind messages that are
+		bool reject = isVolatile || _config.ratePolicy == SIOConfig::RATE_REJECT;
+		bool held = !reject && queue.push(key, prefix + payload, coalesce);
+		{
+			Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+			if(held)
+				endpointState(key).limiter.countThrottled();
+			else
+				endpointState(key).limiter.countDropped();
+		}
+		if(held)
+		{
+			SIO_LOG_DEBUG(_logger, "Holding message (%s) over the rate limit",SIOLogPayload(prefix + payload));
+			startPacing();
+			return true;
+		}
+		if(reject)
+			SIO_LOG_DEBUG(_logger, "Dropping message (%s) over the rate limit",SIOLogPayload(prefix + payload));
+		else
+			SIO_LOG_WARNING(_logger, "Cant send the message (%s) because the rate queue is full",SIOLogPayload(prefix + payload));
+		return isVolatile;
+	}
+	else if(isVolatile)
+	{
+		SIO_LOG_DEBUG(_logger, "Dropping volatile message (%s) because disconnected",SIOLogPayload(prefix + payload));
+		return true;
+	}
+	if(!_offline.push(key, prefix + payload, coalesce))
+	{
+		SIO_LOG_WARNING(_logger, "Cant send the message (%s) because the offline buffer is full",SIOLogPayload(prefix + payload));
+		return false;
+	}
+	SIO_LOG_DEBUG(_logger, "Buffered message (%s)",SIOLogPayload(prefix + payload));
+	return true;
+}
+
+int SIOClientImpl::sendFrame(const char *data, int size, SIOSendQueue::Lane lane)
+{
+	std::string prefix;
+	std::string payload(data, size);
+	return sendFrame(prefix, payload, lane);
+}
+
+int SIOClientImpl::sendFrame(std::string &prefix, std::string &payload, SIOSendQueue::Lane lane, const std::string &key)
+{
+	int size = prefix.size() + payload.size();
+	_sendQueue.push(lane, prefix, payload, key);
+	return size;
+}
+
+int SIOClientImpl::sendFrames(std::vector<std::string> &frames, SIOSendQueue::Lane lane)
+{
+	int size = 0;
+	for(std::size_t i = 0; i < frames.size(); ++i)
+		size += frames[i].size();
+	_sendQueue.push(lane, frames);
+	return size;
+}
+
+void SIOClientImpl::writeLoop()
+{
+	socketThread = this;
+	std::vector<SIOSendQueue::Frame> batch;
+	while(_sendQueue.pop(batch, _config.writeBatchBytes))
+	{
+		try
+		{
+			if(!batch.empty())
+				writeBatch(batch);
+		}
+		catch(Poco::Exception &e)
+		{
+			SIO_LOG_WARNING(_logger, "Write failed: %s",e.displayText());
+			shutdownSocket();
+		}
+		batch.clear();
+
+		//an empty batch only comes from a clear, for the drain event below
+		if(_sendQueue.takeDrained())
+			fireAll("drain", new Poco::JSON::Array());
+	}
+	//the queue is only closed by disconnect() and the destructor
+	if(_closing)
+		shutdownSocket();
+}
+
+void SIOClientImpl::writeBatch(std::vector<SIOSendQueue::Frame> &batch)
+{
+	Poco::FastMutex::ScopedLock lock(_sendMutex);
+	if(!_ws)
+	{
+		if(!_replaying)
+			SIO_LOG_WARNING(_logger, "Dropping %d frames, the socket is closed",(int)batch.size());
+		return;
+	}
+
+	std::size_t bytes = 0;
+	for(std::size_t i = 0; i < batch.size(); ++i)
+		bytes += batch[i].prefix.size() + batch[i].payload.size();
+	_metrics.framesOut.add(batch.size());
+	_metrics.bytesOut.add(bytes);
+
+	if(batch.size() == 1)
+	{
+		if(_tracer->enabled())
+			_tracer->record(_traceId, SIOTracer::OUT, WebSocket::FRAME_TEXT, batch[0].prefix.data(), batch[0].prefix.size(),
+				batch[0].payload.data(), batch[0].payload.size());
+		if(_capture->enabled())
+			capture(SIOCapture::OUT, WebSocket::FRAME_TEXT, batch[0].prefix.data(), batch[0].prefix.size(),
+				batch[0].payload.data(), batch[0].payload.size());
+		writeFrame(batch[0].prefix, batch[0].payload);
+		return;
+	}
+
+	std::vector<std::string> frames(batch.size());
+	for(std::size_t i = 0; i < batch.size(); ++i)
+	{
+		frames[i].swap(batch[i].prefix);
+		frames[i].append(batch[i].payload);
+		if(_tracer->enabled())
+			_tracer->record(_traceId, SIOTracer::OUT, WebSocket::FRAME_TEXT, NULL, 0, frames[i].data(), frames[i].size());
+		if(_capture->enabled())
+			capture(SIOCapture::OUT, WebSocket::FRAME_TEXT, NULL, 0, frames[i].data(), frames[i].size());
+	}
+	writeFrames(frames);
+}
+
+int SIOClientImpl::writeFrames(std::vector<std::string> &frames)
+{
+	std::vector<int> flags(frames.size(), WebSocket::FRAME_TEXT);
+	if(_deflate)
+	{
+		for(std::size_t i = 0; i < frames.size(); ++i)
+		{
+			std::string compressed;
+			if(frames[i].size() >= _deflate->threshold() && _deflate->compress(frames[i].data(), frames[i].size(), compressed))
+			{
+				frames[i].swap(compressed);
+				flags[i] |= WebSocket::FRAME_FLAG_RSV1;
+			}
+		}
+	}
+
+	//one scatter/gather write for the whole batch when possible
+	if(_frameWriter)
+		return _frameWriter->sendFrames(frames, flags);
+
+	int sent = 0;
+	for(std::size_t i = 0; i < frames.size(); ++i)
+		sent += _ws->sendFrame(frames[i].data(), frames[i].size(), flags[i]);
+	return sent;
+}
+
+int SIOClientImpl::writeFrame(std::string &prefix, std::string &payload)
+{
+	std::size_t size = prefix.size() + payload.size();
+	if(_deflate && size >= _deflate->threshold())
+	{
+		std::string frame = prefix + payload;
+		std::string compressed;
+		if(_deflate->compress(frame.data(), frame.size(), compressed))
+		{
+			if(_frameWriter)
+			{
+				std::string none;
+				_frameWriter->sendFrame(none, compressed, WebSocket::FRAME_TEXT | WebSocket::FRAME_FLAG_RSV1);
+			}
+			else
+				_ws->sendFrame(compressed.data(), compressed.size(), WebSocket::FRAME_TEXT | WebSocket::FRAME_FLAG_RSV1);
+			return size;
+		}
+		SIO_LOG_WARNING(_logger, "Compression failed, sending the frame uncompressed");
+	}
+
+	if(_frameWriter)
+		return _frameWriter->sendFrame(prefix, payload, WebSocket::FRAME_TEXT);
+	if(prefix.empty())
+		return _ws->sendFrame(payload.data(), payload.size());
+	std::string frame = prefix + payload;
+	return _ws->sendFrame(frame.data(), frame.size());
 }
 
 bool SIOClientImpl::receive()
@@ -388,233 +1416,335 @@ bool SIOClientImpl::receive()
 	int n;
 
 	n = _ws->receiveFrame(_buffer, _buffer_size, flags);
-	_logger->information("I received something...bytes received: %d ",n);
+	SIO_LOG_TRACE(_logger, "I received something...bytes received: %d ",n);
 
-	SocketIOPacket *packetOut;
+	if(n <= 0 || (flags & WebSocket::FRAME_OP_BITMASK) == WebSocket::FRAME_OP_CLOSE)
+	{
+		SIO_LOG_INFORMATION(_logger, "WebSocket closed by the server");
+		_connected = false;
+		return false;
+	}
 
-	std::stringstream s;
-	for(int i = 0; i < n; i++) {
-		s << _buffer[i];
+	_frameReceived.update();
+	{
+		Poco::FastMutex::ScopedLock lock(_statsMutex);
+		_lastReceived = _frameReceived;
 	}
-	SIOClient *c;
+
+	const char *data = _buffer;
+	std::size_t size = n;
+	std::string inflated;
+	if(_deflate && (flags & WebSocket::FRAME_FLAG_RSV1))
+	{
+		if(!_deflate->decompress(_buffer, n, inflated))
+		{
+			SIO_LOG_ERROR(_logger, "Cannot inflate the received frame");
+			_metrics.parseErrors.add(1);
+			return false;
+		}
+		data = inflated.data();
+		size = inflated.size();
+	}
+
+	return processFrame(data, size, flags);
+}
+
+SIOClientImpl* SIOClientImpl::replay(URI uri, SocketIOPacket::SocketIOVersion version, const SIOConfig &config)
+{
+	SIOClientImpl *s = new SIOClientImpl(uri, config);
+	s->_logger = &(Logger::get("SIOClientLog"));
+	s->_version = version;
+	s->_replaying = true;
+	s->_connected = true;
+	SIOMetrics::instance()->addSocket(s);
+	s->_writerThread.start(s->_writerAdapter);
+	if(config.asyncDispatch)
+		s->_dispatchThread.start(s->_dispatchAdapter);
+	return s;
+}
+
+bool SIOClientImpl::replayFrame(const char *data, std::size_t size, int flags)
+{
+	_frameReceived.update();
+	return processFrame(data, size, flags);
+}
+
+void SIOClientImpl::capture(SIOCapture::Type type, int flags, const char *head, std::size_t headSize, const char *data, std::size_t size)
+{
+	SIOFrameHeader header;
+	const char *frame = headSize > 0 ? head : data;
+	std::size_t frameSize = headSize > 0 ? headSize : size;
+	bool found = _version == SocketIOPacket::V10x
+		? SIOFrameScanner::parseV10x(frame, frameSize, header) && header.type == 4
+		//everything but heartbeats and noops is addressed to an endpoint
+		: SIOFrameScanner::parseV09x(frame, frameSize, header) && header.type != 2 && header.type != 8;
+	_capture->record(_traceId, type, flags, found ? header.endpoint : NULL, found ? header.endpointSize : 0,
+		head, headSize, data, size);
+}
+
+bool SIOClientImpl::processFrame(const char *data, std::size_t size, int flags)
+{
+	if(_tracer->enabled())
+		_tracer->record(_traceId, SIOTracer::IN, flags, NULL, 0, data, size);
+	if(_capture->enabled())
+		capture(SIOCapture::IN, flags, NULL, 0, data, size);
+	_metrics.framesIn.add(1);
+	_metrics.bytesIn.add(size);
+
+	if(_config.validateUTF8 && (flags & WebSocket::FRAME_OP_BITMASK) == WebSocket::FRAME_OP_TEXT
+		&& !SIOFrameScanner::validUTF8(data, size))
+	{
+		SIO_LOG_WARNING(_logger, "Dropping a text frame that is not valid UTF-8");
+		_metrics.parseErrors.add(1);
+		return false;
+	}
+
+	//decoding is what the frame took outside of dispatch()
+	Poco::UInt64 dispatched = _metrics.dispatchMicros.get();
+	bool handled = handleFrame(data, size);
+	Poco::Int64 decode = _frameReceived.elapsed() - (Poco::Int64)(_metrics.dispatchMicros.get() - dispatched);
+	if(decode > 0)
+		_metrics.decodeMicros.add(decode);
+	return handled;
+}
+
+bool SIOClientImpl::handleFrame(const char *data, std::size_t size)
+{
+	SocketIOPacket *packetOut;
+	SIOFrameHeader header;
+
+	Poco::AutoPtr<SIOClient> c;
 	std::stringstream suri;
-	suri << _uri.getHost() << ":" << _uri.getPort() << _uri.getPath();
+	//clients are registered as host:port + endpoint, whichever namespace opened this socket
+	suri << _uri.getHost() << ":" << _uri.getPort();
 	std::string uri = suri.str();
 
 	switch(_version)
 	{
 		case SocketIOPacket::V09x:
 		{
-			const char first = s.str().at(0);
-			int control = atoi(&first);
-			_logger->information("buffer received: [%s]\tControl code: [%i]",s.str(),control);
-			StringTokenizer st(s.str(), ":");
-			std::string endpoint = st[2];
+			if(!SIOFrameScanner::parseV09x(data, size, header))
+			{
+				SIO_LOG_WARNING(_logger, "Invalid frame received: [%s]",SIOLogPayload(data, size));
+				_metrics.parseErrors.add(1);
+				return false;
+			}
+			int control = header.type;
+			SIO_LOG_DEBUG(_logger, "buffer received: [%s]\tControl code: [%i]",SIOLogPayload(data, size),control);
+			std::string endpoint(header.endpoint, header.endpointSize);
 
-			std::stringstream ss;
 			uri += endpoint;
-			_logger->information("URI:%s",uri);
+			SIO_LOG_TRACE(_logger, "URI:%s",uri);
 
-			c = SIOClientRegistry::instance()->getClient(uri);
+			c = clientOf(uri);
 
-			std::string payload = "";
+			std::string payload(header.payload, header.payloadSize);
+			bool dispatch = false;
 			packetOut = SocketIOPacket::createPacketWithTypeIndex(control,_version);
 			packetOut->setEndpoint(endpoint);
 
 			switch(control)
 			{
 				case 0:
-					_logger->information("Socket Disconnected");
+					SIO_LOG_INFORMATION(_logger, "Socket Disconnected");
+					setEndpointStatus(endpoint, ENDPOINT_DISCONNECTED);
 					break;
 				case 1:
-					_logger->information("Connected to endpoint: %s", st[2]);
+					SIO_LOG_INFORMATION(_logger, "Connected to endpoint: %s", endpoint);
+					setEndpointStatus(endpoint, ENDPOINT_CONNECTED);
+					flushOffline(endpoint);
 					break;
 				case 2:
-					_logger->information("Heartbeat received");
+					SIO_LOG_DEBUG(_logger, "Heartbeat received");
 					break;
 				case 3:
-					if(st.count() >= 3)
-					{
-						for(int i = 3; i < st.count(); i++)
-						{//merge piece that have been separated because they contain ':'
-							if(i != 3) payload += ":";
-								payload += st[i];
-						}
-						_logger->information("Message received(%s)",payload);
-					}
+					SIO_LOG_DEBUG(_logger, "Message received(%s)",SIOLogPayload(payload));
 					packetOut->setEvent("message");
 					packetOut->addData(payload);
-					c->getNCenter()->postNotification(new SIOEvent(c,packetOut));
+					dispatch = true;
 					break;
 				case 4:
-					if(st.count() >= 3)
-					{
-						for(int i = 3; i < st.count(); i++)
-						{//merge piece that have been separated because they contain ':'
-							if(i != 3) payload += ":";
-								payload += st[i];
-						}
-						_logger->information("JSON Message Received(%s)",payload);
-					}
+					SIO_LOG_DEBUG(_logger, "JSON Message Received(%s)",SIOLogPayload(payload));
 					packetOut->setEvent("message");
 					packetOut->addData(payload);
-					c->getNCenter()->postNotification(new SIOEvent(c,packetOut));
+					dispatch = true;
 					break;
 				case 5:
 				{
-					if(st.count() >= 3)
+					SIO_LOG_DEBUG(_logger, "Event Dispatched (%s)",SIOLogPayload(payload));
+					if(!SIOJSON::parseEvent(payload, _version, packetOut))
 					{
-						for(int i = 3; i < st.count(); i++)
-						{//merge piece that have been separated because they contain ':'
-							if(i != 3) payload += ":";
-							payload += st[i];
-						}
-						_logger->information("Event Dispatched (%s)",payload);
-						ParseHandler::Ptr pHandler = new ParseHandler(false);
-						Parser parser(pHandler);
-						Var result = parser.parse(payload);
-						Object::Ptr msg = result.extract<Object::Ptr>();
-						packetOut->setEvent(msg->get("name"));
-						packetOut->addData(msg->getArray("args"));
-						c->getNCenter()->postNotification(new SIOEvent(c,packetOut));
+						SIO_LOG_WARNING(_logger, "Cannot parse event (%s)",SIOLogPayload(payload));
+						_metrics.parseErrors.add(1);
 					}
+					else
+						dispatch = true;
 				}break;
 				case 6:
-					_logger->information("Message Ack");
+					SIO_LOG_DEBUG(_logger, "Message Ack");
 					break;
 				case 7:
-					_logger->information("Error");
+					SIO_LOG_DEBUG(_logger, "Error");
 					break;
 				case 8:
-					_logger->information("Noop");
+					SIO_LOG_DEBUG(_logger, "Noop");
 					break;
 			}
+
+			//messages and parsed events are handed to the client of the endpoint
+			if(dispatch)
+			{
+				if(c)
+				{
+					this->dispatch(c, uri, packetOut, size);
+					packetOut = NULL;
+				}
+				else
+					SIO_LOG_WARNING(_logger, "No client for %s",uri);
+			}
+			delete packetOut;
 		}break;
 
 		case SocketIOPacket::V10x:
 		{
-			const char first = s.str().at(0);
-			std::string data = s.str().substr(1);
-			int control = atoi(&first);
-			_logger->information("Buffer received: [%s]\tControl code: [%i]",s.str(),control);
+			if(!SIOFrameScanner::parseV10x(data, size, header))
+			{
+				SIO_LOG_WARNING(_logger, "Invalid frame received: [%s]",SIOLogPayload(data, size));
+				_metrics.parseErrors.add(1);
+				return false;
+			}
+			int control = header.type;
+			SIO_LOG_DEBUG(_logger, "Buffer received: [%s]\tControl code: [%i]",SIOLogPayload(data, size),control);
 			switch(control)
 			{
 				case 0:
-					_logger->information("Not supposed to receive control 0 for websocket");
-					_logger->warning("That's not good");
+					SIO_LOG_INFORMATION(_logger, "Not supposed to receive control 0 for websocket");
+					SIO_LOG_WARNING(_logger, "That's not good");
 					break;
 				case 1:
-					_logger->information("Not supposed to receive control 1 for websocket");
+					SIO_LOG_INFORMATION(_logger, "Not supposed to receive control 1 for websocket");
 					break;
 				case 2:
-					_logger->information("Ping received, send pong");
-					data = "3"+data;
-					_ws->sendFrame(data.c_str(),data.size());
-					break;
+				{
+					SIO_LOG_DEBUG(_logger, "Ping received, send pong");
+					std::string pong = "3" + std::string(header.payload, header.payloadSize);
+					sendFrame(pong.c_str(),pong.size());
+				}	break;
 				case 3:
-					_logger->information("Pong received");
-					if(data == "probe")
+					SIO_LOG_DEBUG(_logger, "Pong received");
+					if(header.payloadSize == 5 && memcmp(header.payload, "probe", 5) == 0)
+					{
+						SIO_LOG_INFORMATION(_logger, "Request Update");
+						sendFrame("5",1);
+					}
+					else
 					{
-						_logger->information("Request Update");
-						_ws->sendFrame("5",1);
+						Poco::Timestamp::TimeDiff rtt = -1;
+						{
+							Poco::FastMutex::ScopedLock lock(_statsMutex);
+							if(_pingPending)
+							{
+								rtt = _pingSent.elapsed();
+								_rtt.add(rtt);
+								_pingPending = false;
+							}
+						}
+						if(rtt >= 0)
+						{
+							SIO_LOG_DEBUG(_logger, "Ping round trip %d us",(int)rtt);
+							Poco::JSON::Array::Ptr args = new Poco::JSON::Array();
+							args->add((int)(rtt/1000));
+							fireAll("pong", args);
+						}
 					}
 					break;
 				case 4:
 				{
 					packetOut = SocketIOPacket::createPacketWithType("event",_version);
-					const char second = data.at(0);
-					data = data.substr(1);
-					int nendpoint = data.find("[");
-					std::string endpoint = "";
-					if(nendpoint != std::string::npos)
-					{
-						endpoint += data.substr(0,nendpoint);
-						data = data.substr(nendpoint);
-						uri+=endpoint;
-					}
+					std::string endpoint(header.endpoint, header.endpointSize);
+					uri+=endpoint;
 					packetOut->setEndpoint(endpoint);
-					c = SIOClientRegistry::instance()->getClient(uri);
+					c = clientOf(uri);
 
-					control = atoi(&second);
-					_logger->information("Message code: [%i]",control);
+					control = header.subtype;
+					SIO_LOG_DEBUG(_logger, "Message code: [%i]",control);
 					switch(control)
 					{
 						case 0:
-							_logger->information("Socket Connected");
-							_connected = true;
-							break;
+						{
+							SIO_LOG_INFORMATION(_logger, "Socket Connected");
+							setEndpointStatus(endpoint, ENDPOINT_CONNECTED);
+							std::string sid, pid;
+							if(_config.stateRecovery && header.payloadSize > 0
+								&& SIOJSON::parseConnect(std::string(header.payload, header.payloadSize), sid, pid))
+							{
+								Poco::FastMutex::ScopedLock lock(_endpointsMutex);
+								EndpointState &state = endpointState(endpoint);
+								state.recovered = !pid.empty() && pid == state.pid;
+								if(state.recovered)
+									SIO_LOG_INFORMATION(_logger, "Session of \"%s\" recovered from offset %s",endpoint,state.offset);
+								else
+								{
+									//a new session, the old offsets mean nothing to the server
+									state.offset.clear();
+									state.recent.clear();
+									state.next = 0;
+								}
+								state.pid = pid;
+							}
+							flushOffline(endpoint);
+						}	break;
 						case 1:
-							_logger->information("Socket Disconnected");
-							//this->disconnect("/");//FIXME the server is telling us it is disconnecting
+							SIO_LOG_INFORMATION(_logger, "Socket Disconnected");
+							setEndpointStatus(endpoint, ENDPOINT_DISCONNECTED);
 							break;
 						case 2:
 						{
-							_logger->information("Event Dispatched (%s)",data);
-							ParseHandler::Ptr pHandler = new ParseHandler(false);
-							Parser parser(pHandler);
-							Var result = parser.parse(data);
-							Array::Ptr msg = result.extract<Array::Ptr>();
-							packetOut->setEvent(msg->get(0));
-							for(int i = 1; i < msg->size() ; ++i)
-								packetOut->addData(msg->get(i).toString());
-							c->getNCenter()->postNotification(new SIOEvent(c,packetOut));
-
-
-//							//42["message","{\"type\":\"redirect\",\"url\":\"/logout\",\"rid\":\"test\",\"info\":\"Internal error: could not get csInfo.\",\"action\":\"reject\"}"]
-//							size_t start_pos = 0;
-//							std::string from = "\\\"", to = "\"";
-//							while((start_pos = data.find(from, start_pos)) != std::string::npos)
-//							{
-//								data.replace(start_pos, from.length(), to);
-//								start_pos += to.length();
-//							}
-//							std::string eventtype;
-//							std::string databody;
-//							std::string endpoint;
-//							_logger->information("Parse this: %s",data);
-//							int one,two;
-//							one = data.find("\"")+1;
-//							two = data.find("\"",one);
-//							eventtype = data.substr(one,two-one);
-//							one = data.find("{");
-//							two = data.find_last_of("}")+1;
-//							databody = data.substr(one,two-one);
-//
-//
-//							uri += endpoint;
-//							c = SIOClientRegistry::instance()->getClient(uri);
-//
-//							_logger->information("Type event is: %s\nData:%s",eventtype,databody);
-//							//if message
-//							if(eventtype == "message")
-//								c->getNCenter()->postNotification(new SIOMessage(c,databody));
-//							else// need to find event
-//							{
-//								std::string eventPayload = "{\"name\":\""+eventtype+"\",\"args\":["+databody+"]}";
-//								//{"name":"event","args":[{"type":"emit Without backslash"}]}
-//								c->getNCenter()->postNotification(new SIOEvent(c, eventPayload));
-//							}
-
+							std::string payload(header.payload, header.payloadSize);
+							SIO_LOG_DEBUG(_logger, "Event Dispatched (%s)",SIOLogPayload(payload));
+							if(!SIOJSON::parseEvent(payload, _version, packetOut))
+							{
+								SIO_LOG_WARNING(_logger, "Cannot parse event (%s)",SIOLogPayload(payload));
+								_metrics.parseErrors.add(1);
+								break;
+							}
+							if(_config.stateRecovery && hasPid(endpoint))
+							{
+								std::string offset;
+								if(SIOJSON::parseOffset(payload, offset) && seenOffset(endpoint, offset))
+								{
+									SIO_LOG_DEBUG(_logger, "Dropping replayed event at offset %s",offset);
+									break;
+								}
+							}
+							if(!c)
+							{
+								SIO_LOG_WARNING(_logger, "No client for %s",uri);
+								break;
+							}
+							dispatch(c, uri, packetOut, size);
+							packetOut = NULL;
 						}	break;
 						case 3:
-							_logger->information("Message Ack");
+							SIO_LOG_DEBUG(_logger, "Message Ack");
 							break;
 						case 4:
-							_logger->information("Error");
+							SIO_LOG_DEBUG(_logger, "Error");
 							break;
 						case 5:
-							_logger->information("Binary Event");
+							SIO_LOG_DEBUG(_logger, "Binary Event");
 							break;
 						case 6:
-							_logger->information("Binary Ack");
+							SIO_LOG_DEBUG(_logger, "Binary Ack");
 							break;
 					}
+					delete packetOut;
 				}break;
 				case 5:
-					_logger->information("Upgrade required");
+					SIO_LOG_INFORMATION(_logger, "Upgrade required");
 					break;
 				case 6:
-					_logger->information("Noop");
+					SIO_LOG_DEBUG(_logger, "Noop");
 					break;
 			}
 		}break;
@@ -624,10 +1754,41 @@ bool SIOClientImpl::receive()
 
 }
 
-void SIOClientImpl::addref() {
+void SIOClientImpl::duplicate() {
 	_refCount++;
 }
 
+bool SIOClientImpl::tryDuplicate() {
+	int count = _refCount.load();
+	while(count > 0)
+	{
+		if(_refCount.compare_exchange_weak(count, count + 1))
+			return true;
+	}
+	return false;
+}
+
 void SIOClientImpl::release() {
-	if(--_refCount == 0) delete this;
+	if(--_refCount > 0)
+		return;
+	//the destructor joins the threads of the socket: when the last reference
+	//goes on one of them (a client released by a handler), a pool thread
+	//deletes it and this thread winds down on the way
+	if(socketThread != this)
+	{
+		delete this;
+		return;
+	}
+	try
+	{
+		Poco::ThreadPool::defaultPool().start(_reapAdapter);
+	}
+	catch(Poco::NoThreadAvailableException &)
+	{
+		SIO_LOG_ERROR(_logger, "No thread left to delete the socket to %s, leaking it",_uri.toString());
+	}
+}
+
+void SIOClientImpl::reap() {
+	delete this;
 }
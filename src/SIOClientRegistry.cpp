@@ -1,63 +1,278 @@
 #include "SIOClientRegistry.h"
 #include "SIOClient.h"
 
-SIOClientRegistry *SIOClientRegistry::_inst = NULL;
+#include "Poco/Thread.h"
 
-SIOClientRegistry *SIOClientRegistry::instance() {
-	
-	if(!_inst)
-		_inst = new SIOClientRegistry();
-	
-	return _inst;
+namespace
+{
+	static Poco::SingletonHolder<SIOClientRegistry> sh;
+
+	//Epoch based reclamation of the replaced maps. A reader publishes the
+	//global epoch in its own slot for the time of the lookup; a map replaced
+	//at epoch e can be freed once every busy slot shows a later epoch.
+	enum {READER_SLOTS = 128};
+
+	//one cache line each, readers never write to a line another reader uses
+	struct alignas(64) ReaderSlot
+	{
+		std::atomic<unsigned long long> epoch;//0 when the thread is not reading
+		std::atomic<bool> taken;
+	};
+
+	static ReaderSlot slots[READER_SLOTS];
+	static std::atomic<unsigned long long> globalEpoch(1);
+	static std::atomic<int> slowReaders(0);//readers that found no free slot
+
+	//slot of the calling thread, claimed on its first lookup and freed when it exits
+	struct SlotOwner
+	{
+		SlotOwner() : index(-1), depth(0)
+		{
+			for(int i = 0; i < READER_SLOTS; ++i)
+			{
+				bool expected = false;
+				if(slots[i].taken.compare_exchange_strong(expected, true))
+				{
+					index = i;
+					break;
+				}
+			}
+		}
+
+		~SlotOwner()
+		{
+			if(index >= 0)
+			{
+				slots[index].epoch.store(0);
+				slots[index].taken.store(false);
+			}
+		}
+
+		int index;
+		int depth;
+	};
+
+	static thread_local SlotOwner owner;
+
+	class ReadGuard
+	{
+	public:
+		ReadGuard() : _owner(owner)
+		{
+			if(_owner.depth++ > 0)
+				return;
+			if(_owner.index >= 0)
+				slots[_owner.index].epoch.store(globalEpoch.load());
+			else
+				++slowReaders;
+		}
+
+		~ReadGuard()
+		{
+			if(--_owner.depth > 0)
+				return;
+			if(_owner.index >= 0)
+				slots[_owner.index].epoch.store(0);
+			else
+				--slowReaders;
+		}
+
+	private:
+		SlotOwner &_owner;
+	};
+
+	//true when no reader can still use a map replaced at the given epoch
+	bool quiescent(unsigned long long retiredAt)
+	{
+		if(slowReaders.load() > 0)
+			return false;
+		for(int i = 0; i < READER_SLOTS; ++i)
+		{
+			unsigned long long e = slots[i].epoch.load();
+			if(e != 0 && e <= retiredAt)
+				return false;
+		}
+		return true;
+	}
 
+	//waits for the readers already busy: once a value is unlinked, whoever
+	//unlinked it, none of them can still be about to take a reference to it.
+	//Readers that start later get a newer epoch and are not waited for.
+	void synchronize()
+	{
+		unsigned long long now = globalEpoch.fetch_add(1);
+		while(!quiescent(now))
+			Poco::Thread::yield();
+	}
 }
 
-SIOClient *SIOClientRegistry::getClient(std::string uri)
+SIOClientRegistry *SIOClientRegistry::instance()
 {
-	SIOClient *c = NULL;
-//	std::cout << "Search client:" << uri << std::endl;
-	std::map<std::string,SIOClient *>::iterator it = _clientMap.find(uri);
-	if(it != _clientMap.end())
-    {
-		 c = it->second;
-    }
-	return c;
+	return sh.get();
+}
 
+SIOClientRegistry::~SIOClientRegistry()
+{
+	for(int i = 0; i < SHARDS; ++i)
+	{
+		destroy(_clients[i]);
+		destroy(_sockets[i]);
+	}
 }
 
-void SIOClientRegistry::addClient(SIOClient *client)
+std::size_t SIOClientRegistry::shardOf(const std::string &uri)
 {
-//	std::cout << "Add client:" << client->getUri() << std::endl;
-	_clientMap[client->getUri()] = client;
+	//FNV-1a
+	unsigned int h = 2166136261u;
+	for(std::size_t i = 0; i < uri.size(); ++i)
+	{
+		h ^= (unsigned char)uri[i];
+		h *= 16777619u;
+	}
+	return h % SHARDS;
+}
 
+template <class T>
+Poco::AutoPtr<T> SIOClientRegistry::find(Shard<T> &shard, const std::string &uri)
+{
+	ReadGuard guard;
+	const typename Shard<T>::Map *map = shard.map.load();
+	typename Shard<T>::Map::const_iterator it = map->find(uri);
+	//the reference is taken while the guard keeps the object from being freed
+	if(it == map->end() || !it->second->tryDuplicate())
+		return Poco::AutoPtr<T>();
+	return Poco::AutoPtr<T>(it->second);
 }
 
-void SIOClientRegistry::removeClient(std::string uri)
+template <class T>
+Poco::AutoPtr<T> SIOClientRegistry::insert(Shard<T> &shard, const std::string &uri, T *value)
 {
-	_clientMap.erase(uri);
+	Poco::FastMutex::ScopedLock lock(shard.writeMutex);
+	const typename Shard<T>::Map *current = shard.map.load();
+	typename Shard<T>::Map::const_iterator it = current->find(uri);
+	if(it != current->end() && it->second->tryDuplicate())
+		return Poco::AutoPtr<T>(it->second);
+
+	//a value without references left is on its way out, it is replaced
+	typename Shard<T>::Map *copy = new typename Shard<T>::Map(*current);
+	(*copy)[uri] = value;
+	publish(shard, copy);
+	return Poco::AutoPtr<T>(value, true);
 }
 
-SIOClientImpl *SIOClientRegistry::getSocket(std::string uri)
+template <class T>
+void SIOClientRegistry::remove(Shard<T> &shard, const std::string &uri, T *expected)
 {
+	Poco::FastMutex::ScopedLock lock(shard.writeMutex);
+	const typename Shard<T>::Map *current = shard.map.load();
+	typename Shard<T>::Map::const_iterator it = current->find(uri);
+	if(it == current->end() || (expected && it->second != expected))
+		return;
 
-	SIOClientImpl *c = NULL;
-//	std::cout << "Search client:" << uri << std::endl;
-	std::map<std::string,SIOClientImpl *>::iterator it = _socketMap.find(uri);
-	if(it != _socketMap.end())
-    {
-		 c = it->second;
-    }
+	typename Shard<T>::Map *copy = new typename Shard<T>::Map(*current);
+	copy->erase(uri);
+	publish(shard, copy);
+}
 
-	return c;
+template <class T>
+void SIOClientRegistry::publish(Shard<T> &shard, const typename Shard<T>::Map *map)
+{
+	const typename Shard<T>::Map *old = shard.map.exchange(map);
+	shard.retired.push_back(std::make_pair(old, globalEpoch.fetch_add(1)));
+	reclaim(shard);
+}
 
+template <class T>
+void SIOClientRegistry::reclaim(Shard<T> &shard)
+{
+	std::size_t kept = 0;
+	for(std::size_t i = 0; i < shard.retired.size(); ++i)
+	{
+		if(quiescent(shard.retired[i].second))
+			delete shard.retired[i].first;
+		else
+			shard.retired[kept++] = shard.retired[i];
+	}
+	shard.retired.resize(kept);
 }
 
-void SIOClientRegistry::addSocket(SIOClientImpl *socket, std::string uri) {
+template <class T>
+void SIOClientRegistry::destroy(Shard<T> &shard)
+{
+	for(std::size_t i = 0; i < shard.retired.size(); ++i)
+		delete shard.retired[i].first;
+	shard.retired.clear();
+	delete shard.map.load();
+}
 
-	_socketMap[uri] = socket;
+Poco::AutoPtr<SIOClient> SIOClientRegistry::getClient(std::string uri)
+{
+	return find(_clients[shardOf(uri)], uri);
+}
+
+Poco::AutoPtr<SIOClient> SIOClientRegistry::addClient(SIOClient *client)
+{
+	std::string uri = client->getUri();
+	return insert(_clients[shardOf(uri)], uri, client);
+}
+
+void SIOClientRegistry::removeClient(std::string uri)
+{
+	remove<SIOClient>(_clients[shardOf(uri)], uri, NULL);
+}
 
+void SIOClientRegistry::removeClient(SIOClient *client)
+{
+	std::string uri = client->getUri();
+	remove(_clients[shardOf(uri)], uri, client);
+	synchronize();
 }
 
-void SIOClientRegistry::removeSocket(std::string uri) {
-	_socketMap.erase(uri);
+void SIOClientRegistry::getClients(SIOClientImpl *socket, std::vector<Poco::AutoPtr<SIOClient> > &clients)
+{
+	ReadGuard guard;
+	for(int i = 0; i < SHARDS; ++i)
+	{
+		const Shard<SIOClient>::Map *map = _clients[i].map.load();
+		for(Shard<SIOClient>::Map::const_iterator it = map->begin(); it != map->end(); ++it)
+		{
+			if(it->second->getSocket() == socket && it->second->tryDuplicate())
+				clients.push_back(Poco::AutoPtr<SIOClient>(it->second));
+		}
+	}
+}
+
+Poco::AutoPtr<SIOClientImpl> SIOClientRegistry::getSocket(std::string uri)
+{
+	return find(_sockets[shardOf(uri)], uri);
+}
+
+Poco::AutoPtr<SIOClientImpl> SIOClientRegistry::addSocket(SIOClientImpl *socket, std::string uri)
+{
+	return insert(_sockets[shardOf(uri)], uri, socket);
+}
+
+void SIOClientRegistry::removeSocket(std::string uri)
+{
+	remove<SIOClientImpl>(_sockets[shardOf(uri)], uri, NULL);
+}
+
+void SIOClientRegistry::removeSocket(SIOClientImpl *socket)
+{
+	std::vector<std::string> uris;
+	{
+		ReadGuard guard;
+		for(int i = 0; i < SHARDS; ++i)
+		{
+			const Shard<SIOClientImpl>::Map *map = _sockets[i].map.load();
+			for(Shard<SIOClientImpl>::Map::const_iterator it = map->begin(); it != map->end(); ++it)
+			{
+				if(it->second == socket)
+					uris.push_back(it->first);
+			}
+		}
+	}
+	for(std::size_t i = 0; i < uris.size(); ++i)
+		remove(_sockets[shardOf(uris[i])], uris[i], socket);
+	synchronize();
 }
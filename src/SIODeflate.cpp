@@ -0,0 +1,324 @@
+#include "SIODeflate.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "Poco/SingletonHolder.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+
+using Poco::StringTokenizer;
+
+namespace
+{
+	static Poco::SingletonHolder<SIODeflatePool> sh;
+
+	//zlib does not support a raw deflate window of 256 bytes. Only fine where
+	//a larger window is harmless: our own choice, or inflating what the server
+	//compressed with a smaller one
+	int clampWindowBits(int bits)
+	{
+		if(bits < 9) return 9;
+		if(bits > 15) return 15;
+		return bits;
+	}
+
+	int deflaterKey(int windowBits, int memLevel, int level)
+	{
+		return (windowBits << 8) | (memLevel << 4) | level;
+	}
+}
+
+SIODeflatePool::SIODeflatePool() :
+	_maxIdle(16)
+{
+}
+
+SIODeflatePool::~SIODeflatePool()
+{
+	for(StreamMap::iterator it = _deflaters.begin(); it != _deflaters.end(); ++it)
+		for(std::size_t i = 0; i < it->second.size(); ++i)
+		{
+			deflateEnd(it->second[i]);
+			delete it->second[i];
+		}
+	for(StreamMap::iterator it = _inflaters.begin(); it != _inflaters.end(); ++it)
+		for(std::size_t i = 0; i < it->second.size(); ++i)
+		{
+			inflateEnd(it->second[i]);
+			delete it->second[i];
+		}
+}
+
+SIODeflatePool *SIODeflatePool::instance()
+{
+	return sh.get();
+}
+
+void SIODeflatePool::setMaxIdle(std::size_t maxIdle)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_maxIdle = maxIdle;
+}
+
+z_stream *SIODeflatePool::acquireDeflater(int windowBits, int memLevel, int level)
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		std::vector<z_stream *> &idle = _deflaters[deflaterKey(windowBits, memLevel, level)];
+		if(!idle.empty())
+		{
+			z_stream *strm = idle.back();
+			idle.pop_back();
+			return strm;
+		}
+	}
+
+	z_stream *strm = new z_stream;
+	memset(strm, 0, sizeof(z_stream));
+	//negative window bits: raw deflate without zlib header, as required by RFC 7692
+	if(deflateInit2(strm, level, Z_DEFLATED, -windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		delete strm;
+		return NULL;
+	}
+	return strm;
+}
+
+void SIODeflatePool::releaseDeflater(z_stream *strm, int windowBits, int memLevel, int level)
+{
+	deflateReset(strm);
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		std::vector<z_stream *> &idle = _deflaters[deflaterKey(windowBits, memLevel, level)];
+		if(idle.size() < _maxIdle)
+		{
+			idle.push_back(strm);
+			return;
+		}
+	}
+	deflateEnd(strm);
+	delete strm;
+}
+
+z_stream *SIODeflatePool::acquireInflater(int windowBits)
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		std::vector<z_stream *> &idle = _inflaters[windowBits];
+		if(!idle.empty())
+		{
+			z_stream *strm = idle.back();
+			idle.pop_back();
+			return strm;
+		}
+	}
+
+	z_stream *strm = new z_stream;
+	memset(strm, 0, sizeof(z_stream));
+	if(inflateInit2(strm, -windowBits) != Z_OK)
+	{
+		delete strm;
+		return NULL;
+	}
+	return strm;
+}
+
+void SIODeflatePool::releaseInflater(z_stream *strm, int windowBits)
+{
+	inflateReset(strm);
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		std::vector<z_stream *> &idle = _inflaters[windowBits];
+		if(idle.size() < _maxIdle)
+		{
+			idle.push_back(strm);
+			return;
+		}
+	}
+	inflateEnd(strm);
+	delete strm;
+}
+
+SIODeflate::SIODeflate(const SIOConfig &config) :
+	_clientNoContextTakeover(config.deflateNoContextTakeover),
+	//the server only resets its context if its response says so, see accept()
+	_serverNoContextTakeover(false),
+	_clientWindowBits(clampWindowBits(config.deflateWindowBits)),
+	_serverWindowBits(15),
+	_memLevel(config.deflateMemLevel),
+	_level(config.deflateLevel),
+	_threshold(config.deflateThreshold),
+	_deflater(NULL),
+	_inflater(NULL)
+{
+}
+
+SIODeflate::~SIODeflate()
+{
+	if(_deflater)
+		SIODeflatePool::instance()->releaseDeflater(_deflater, _clientWindowBits, _memLevel, _level);
+	if(_inflater)
+		SIODeflatePool::instance()->releaseInflater(_inflater, _serverWindowBits);
+}
+
+std::string SIODeflate::offer() const
+{
+	std::stringstream ss;
+	ss << "permessage-deflate; client_max_window_bits";
+	if(_clientWindowBits < 15)
+		ss << "=" << _clientWindowBits;
+	if(_clientNoContextTakeover)
+		ss << "; client_no_context_takeover; server_no_context_takeover";
+	return ss.str();
+}
+
+bool SIODeflate::accept(const std::string &response)
+{
+	StringTokenizer extensions(response, ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+	for(std::size_t i = 0; i < extensions.count(); ++i)
+	{
+		StringTokenizer params(extensions[i], ";", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+		if(params.count() == 0 || params[0] != "permessage-deflate")
+			continue;
+
+		for(std::size_t j = 1; j < params.count(); ++j)
+		{
+			std::string name = params[j];
+			std::string value;
+			std::size_t eq = name.find('=');
+			if(eq != std::string::npos)
+			{
+				value = Poco::trim(name.substr(eq + 1));
+				name = Poco::trim(name.substr(0, eq));
+				if(!value.empty() && value[0] == '"')
+					value = value.substr(1, value.size() - 2);
+			}
+
+			if(name == "server_no_context_takeover")
+				_serverNoContextTakeover = true;
+			else if(name == "client_no_context_takeover")
+				_clientNoContextTakeover = true;
+			else if(name == "server_max_window_bits" && !value.empty())
+				_serverWindowBits = clampWindowBits(atoi(value.c_str()));
+			else if(name == "client_max_window_bits" && !value.empty())
+			{
+				//compressing with a larger window than agreed would break the
+				//server's inflater, and zlib has nothing below 9
+				int bits = atoi(value.c_str());
+				if(bits < 9 || bits > 15)
+					return false;
+				if(bits < _clientWindowBits)
+					_clientWindowBits = bits;
+			}
+			else
+				return false;//unknown parameter, the negotiation is invalid
+		}
+		return true;
+	}
+	return false;
+}
+
+z_stream *SIODeflate::deflater()
+{
+	if(_clientNoContextTakeover)
+		return SIODeflatePool::instance()->acquireDeflater(_clientWindowBits, _memLevel, _level);
+	if(!_deflater)
+		_deflater = SIODeflatePool::instance()->acquireDeflater(_clientWindowBits, _memLevel, _level);
+	return _deflater;
+}
+
+z_stream *SIODeflate::inflater()
+{
+	if(_serverNoContextTakeover)
+		return SIODeflatePool::instance()->acquireInflater(_serverWindowBits);
+	if(!_inflater)
+		_inflater = SIODeflatePool::instance()->acquireInflater(_serverWindowBits);
+	return _inflater;
+}
+
+void SIODeflate::doneDeflater(z_stream *strm)
+{
+	if(_clientNoContextTakeover)
+		SIODeflatePool::instance()->releaseDeflater(strm, _clientWindowBits, _memLevel, _level);
+}
+
+void SIODeflate::doneInflater(z_stream *strm)
+{
+	if(_serverNoContextTakeover)
+		SIODeflatePool::instance()->releaseInflater(strm, _serverWindowBits);
+}
+
+bool SIODeflate::compress(const char *data, std::size_t size, std::string &out)
+{
+	z_stream *strm = deflater();
+	if(!strm)
+		return false;
+
+	strm->next_in = (Bytef *)data;
+	strm->avail_in = (uInt)size;
+
+	std::size_t used = 0;
+	int ret;
+	out.resize(deflateBound(strm, (uLong)size) + 16);
+	do
+	{
+		if(used == out.size())
+			out.resize(out.size() * 2);
+		strm->next_out = (Bytef *)&out[used];
+		strm->avail_out = (uInt)(out.size() - used);
+		ret = deflate(strm, Z_SYNC_FLUSH);
+		used = out.size() - strm->avail_out;
+	} while(ret == Z_OK && strm->avail_out == 0);
+
+	doneDeflater(strm);
+	if(ret != Z_OK && ret != Z_BUF_ERROR)
+		return false;
+
+	//the sync flush ends with an empty stored block, RFC 7692 7.2.1 drops it
+	if(used >= 4 && memcmp(&out[used - 4], "\x00\x00\xff\xff", 4) == 0)
+		used -= 4;
+	//zlib flushes nothing for an empty message right after a flush, the
+	//inflater would then read the tail as a truncated block: RFC 7692 7.2.3.6
+	//sends an empty stored block header instead
+	if(used == 0)
+		out[used++] = '\0';
+	out.resize(used);
+	return true;
+}
+
+static bool inflateInto(z_stream *strm, const Bytef *data, std::size_t size, std::string &out)
+{
+	strm->next_in = (Bytef *)data;
+	strm->avail_in = (uInt)size;
+
+	std::size_t used = out.size();
+	do
+	{
+		out.resize(used + (size * 4 > 4096 ? size * 4 : 4096));
+		strm->next_out = (Bytef *)&out[used];
+		strm->avail_out = (uInt)(out.size() - used);
+		int ret = inflate(strm, Z_SYNC_FLUSH);
+		used = out.size() - strm->avail_out;
+		if(ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+			return false;
+	} while(strm->avail_out == 0);
+
+	out.resize(used);
+	return true;
+}
+
+bool SIODeflate::decompress(const char *data, std::size_t size, std::string &out)
+{
+	static const Bytef tail[4] = {0x00, 0x00, 0xff, 0xff};
+
+	z_stream *strm = inflater();
+	if(!strm)
+		return false;
+
+	out.clear();
+	bool ok = inflateInto(strm, (const Bytef *)data, size, out) && inflateInto(strm, tail, 4, out);
+	doneInflater(strm);
+	return ok;
+}
@@ -1,4 +1,7 @@
 #include "SIOEventRegistry.h"
+#include "SIOLatency.h"
+
+#include "Poco/Timestamp.h"
 
 SIOEventRegistry::SIOEventRegistry(void)
 {
@@ -10,16 +13,18 @@ SIOEventRegistry::~SIOEventRegistry(void)
 
 bool SIOEventRegistry::registerEvent(const char *name, SIOEventTarget *target, callback c)
 {
-	std::map<std::string,BasicEvent<Array::Ptr> *>::iterator it= mEventMap.find(std::string(name));
+	std::map<std::string,Handlers>::iterator it= mEventMap.find(std::string(name));
 	if(it != mEventMap.end())
     {
-		BasicEvent<Array::Ptr> *e = it->second;
+		BasicEvent<Array::Ptr> *e = it->second.event;
 		*e += Poco::delegate(target, c);
     }else
 	{
-		BasicEvent<Array::Ptr> *e = new BasicEvent<Array::Ptr>();
-		*e += Poco::delegate(target, c);
-		mEventMap[std::string(name)] = e;
+		Handlers handlers;
+		handlers.event = new BasicEvent<Array::Ptr>();
+		*handlers.event += Poco::delegate(target, c);
+		handlers.latency = SIOLatency::instance()->get(name);
+		mEventMap[std::string(name)] = handlers;
 	}
 	
 	return true;
@@ -27,11 +32,13 @@ bool SIOEventRegistry::registerEvent(const char *name, SIOEventTarget *target, c
 
 void SIOEventRegistry::fireEvent(SIOClient *client, const char *name, Array::Ptr data)
 {
-	std::map<std::string,BasicEvent<Array::Ptr> *>::iterator it= mEventMap.find(std::string(name));
+	std::map<std::string,Handlers>::iterator it= mEventMap.find(std::string(name));
 	if(it != mEventMap.end())
     {
-		BasicEvent<Array::Ptr> *e = it->second;
+		BasicEvent<Array::Ptr> *e = it->second.event;
+		Poco::Timestamp start;
 		e->notify(client, data);
+		it->second.latency->handler.record(start.elapsed());
     }else
 	{
 		//no event handler found
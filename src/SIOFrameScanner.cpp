@@ -0,0 +1,197 @@
+#include "SIOFrameScanner.h"
+
+#include <cstring>
+
+#include "Poco/Foundation.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIO_SCAN_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef SIO_SCAN_SSE2
+static inline int lowestBit(int mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+const char *SIOFrameScanner::find(const char *p, const char *end, char c)
+{
+#ifdef SIO_SCAN_SSE2
+	__m128i needle = _mm_set1_epi8(c);
+	for(; end - p >= 16; p += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+		if(mask)
+			return p + lowestBit(mask);
+	}
+	for(; p < end; ++p)
+		if(*p == c)
+			return p;
+	return end;
+#else
+	const void *found = memchr(p, c, end - p);
+	return found ? (const char *)found : end;
+#endif
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+bool SIOFrameScanner::parseV09x(const char *data, std::size_t size, SIOFrameHeader &out)
+{
+	if(size == 0 || !isDigit(data[0]))
+		return false;
+
+	const char *end = data + size;
+	out.type = data[0] - '0';
+	out.subtype = -1;
+	out.id = out.endpoint = out.payload = end;
+	out.idSize = out.endpointSize = out.payloadSize = 0;
+
+	//only the three header delimiters are looked for, the data may contain ':'
+	const char *c1 = find(data + 1, end, ':');
+	if(c1 == end)
+		return true;
+	const char *c2 = find(c1 + 1, end, ':');
+	out.id = c1 + 1;
+	out.idSize = c2 - out.id;
+	if(c2 == end)
+		return true;
+	const char *c3 = find(c2 + 1, end, ':');
+	out.endpoint = c2 + 1;
+	out.endpointSize = c3 - out.endpoint;
+	if(c3 == end)
+		return true;
+	out.payload = c3 + 1;
+	out.payloadSize = end - out.payload;
+	return true;
+}
+
+bool SIOFrameScanner::parseV10x(const char *data, std::size_t size, SIOFrameHeader &out)
+{
+	if(size == 0 || !isDigit(data[0]))
+		return false;
+
+	const char *end = data + size;
+	const char *p = data + 1;
+	out.type = data[0] - '0';
+	out.subtype = -1;
+	out.id = out.endpoint = p;
+	out.idSize = out.endpointSize = 0;
+
+	if(out.type == 4 && p < end && isDigit(*p))
+	{
+		out.subtype = *p++ - '0';
+
+		if(p < end && *p == '/')
+		{
+			//the namespace ends at the comma, or at the data of a packet sent without one
+			const char *comma = find(p, end, ',');
+			const char *nsEnd = find(p, comma, '[');
+			out.endpoint = p;
+			out.endpointSize = nsEnd - p;
+			p = nsEnd;
+			if(p < end && *p == ',')
+				++p;
+		}
+
+		out.id = p;
+		while(p < end && isDigit(*p))
+			++p;
+		out.idSize = p - out.id;
+	}
+
+	out.payload = p;
+	out.payloadSize = end - p;
+	return true;
+}
+
+bool SIOFrameScanner::validUTF8(const char *data, std::size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+
+	while(p < end)
+	{
+		//skip ASCII in bulk
+#ifdef SIO_SCAN_SSE2
+		while(end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p)) == 0)
+			p += 16;
+#else
+		while(end - p >= 8)
+		{
+			Poco::UInt64 w;
+			memcpy(&w, p, 8);
+			if(w & 0x8080808080808080ULL)
+				break;
+			p += 8;
+		}
+#endif
+		if(p >= end)
+			break;
+
+		unsigned char c = *p;
+		if(c < 0x80)
+		{
+			++p;
+			continue;
+		}
+
+		//lead byte: number of continuation bytes and the valid range of the
+		//first one, which rules out overlongs, surrogates and > U+10FFFF
+		int n;
+		unsigned char lo = 0x80, hi = 0xBF;
+		if(c >= 0xC2 && c <= 0xDF)
+			n = 1;
+		else if(c == 0xE0)
+		{
+			n = 2;
+			lo = 0xA0;
+		}
+		else if(c == 0xED)
+		{
+			n = 2;
+			hi = 0x9F;
+		}
+		else if(c >= 0xE1 && c <= 0xEF)
+			n = 2;
+		else if(c == 0xF0)
+		{
+			n = 3;
+			lo = 0x90;
+		}
+		else if(c >= 0xF1 && c <= 0xF3)
+			n = 3;
+		else if(c == 0xF4)
+		{
+			n = 3;
+			hi = 0x8F;
+		}
+		else
+			return false;
+
+		if(end - p <= n)
+			return false;
+		if(p[1] < lo || p[1] > hi)
+			return false;
+		for(int i = 2; i <= n; ++i)
+			if((p[i] & 0xC0) != 0x80)
+				return false;
+		p += n + 1;
+	}
+	return true;
+}
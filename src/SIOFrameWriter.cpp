@@ -0,0 +1,224 @@
+#include "SIOFrameWriter.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define SIO_NO_WRITEV
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+//same as writev, but a peer reset must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define SIO_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SIO_SEND_FLAGS 0
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIO_MASK_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define SIO_MASK_AVX2
+#include <immintrin.h>
+#endif
+
+#include "Poco/Exception.h"
+#include "Poco/Net/NetException.h"
+
+SIOFrameWriter::SIOFrameWriter(Poco::Net::StreamSocket &socket) :
+	_socket(socket)
+{
+	_rnd.seed();
+}
+
+bool SIOFrameWriter::supported()
+{
+#ifdef SIO_NO_WRITEV
+	return false;
+#else
+	return true;
+#endif
+}
+
+void SIOFrameWriter::mask(char *data, std::size_t size, const unsigned char key[4], std::size_t offset)
+{
+	//rotate the key so that k[0] applies to data[0]
+	unsigned char k[4];
+	for(int i = 0; i < 4; ++i)
+		k[i] = key[(offset + i) & 3];
+
+	Poco::UInt32 k32;
+	memcpy(&k32, k, 4);
+
+	std::size_t i = 0;
+#ifdef SIO_MASK_AVX2
+	__m256i k256 = _mm256_set1_epi32((int)k32);
+	for(; i + 32 <= size; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+		_mm256_storeu_si256((__m256i *)(data + i), _mm256_xor_si256(v, k256));
+	}
+#endif
+#ifdef SIO_MASK_SSE2
+	__m128i k128 = _mm_set1_epi32((int)k32);
+	for(; i + 16 <= size; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		_mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, k128));
+	}
+#endif
+	//scalar fallback a word at a time, every step above is a multiple of 4
+	//bytes so the key phase is unchanged
+	Poco::UInt64 k64 = ((Poco::UInt64)k32 << 32) | k32;
+	for(; i + 8 <= size; i += 8)
+	{
+		Poco::UInt64 v;
+		memcpy(&v, data + i, 8);
+		v ^= k64;
+		memcpy(data + i, &v, 8);
+	}
+	for(; i < size; ++i)
+		data[i] ^= k[i & 3];
+}
+
+std::size_t SIOFrameWriter::writeHeader(unsigned char *header, int flags, Poco::UInt64 length, const unsigned char key[4])
+{
+	std::size_t n = 0;
+	//the FIN/RSV/opcode flags of WebSocket::sendFrame are laid out like the first header byte
+	header[n++] = (unsigned char)(flags & 0xff);
+	if(length < 126)
+		header[n++] = (unsigned char)(0x80 | length);
+	else if(length < 65536)
+	{
+		header[n++] = 0x80 | 126;
+		header[n++] = (unsigned char)(length >> 8);
+		header[n++] = (unsigned char)(length);
+	}
+	else
+	{
+		header[n++] = 0x80 | 127;
+		for(int i = 7; i >= 0; --i)
+			header[n++] = (unsigned char)(length >> (i * 8));
+	}
+	memcpy(header + n, key, 4);
+	return n + 4;
+}
+
+#ifndef SIO_NO_WRITEV
+//write all the buffers, a partial write can stop inside any of them
+static void sendAll(int fd, struct iovec *next, int count)
+{
+	while(count > 0)
+	{
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = next;
+		msg.msg_iovlen = count;
+		ssize_t sent = sendmsg(fd, &msg, SIO_SEND_FLAGS);
+		if(sent < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				throw Poco::TimeoutException();
+			throw Poco::Net::NetException("sendmsg failed", errno);
+		}
+		while(count > 0 && (std::size_t)sent >= next->iov_len)
+		{
+			sent -= next->iov_len;
+			++next;
+			--count;
+		}
+		if(count > 0)
+		{
+			next->iov_base = (char *)next->iov_base + sent;
+			next->iov_len -= sent;
+		}
+	}
+}
+#endif
+
+void SIOFrameWriter::newKey(unsigned char key[4])
+{
+	Poco::UInt32 r = _rnd.next();
+	memcpy(key, &r, 4);
+}
+
+int SIOFrameWriter::sendFrame(std::string &prefix, std::string &payload, int flags)
+{
+	unsigned char key[4];
+	newKey(key);
+
+	unsigned char header[14];
+	std::size_t length = prefix.size() + payload.size();
+	std::size_t headerSize = writeHeader(header, flags, length, key);
+
+	if(!prefix.empty())
+		mask(&prefix[0], prefix.size(), key, 0);
+	if(!payload.empty())
+		mask(&payload[0], payload.size(), key, prefix.size());
+
+#ifdef SIO_NO_WRITEV
+	throw Poco::NotImplementedException("sendmsg");
+#else
+	struct iovec iov[3];
+	int count = 0;
+	iov[count].iov_base = header;
+	iov[count++].iov_len = headerSize;
+	if(!prefix.empty())
+	{
+		iov[count].iov_base = &prefix[0];
+		iov[count++].iov_len = prefix.size();
+	}
+	if(!payload.empty())
+	{
+		iov[count].iov_base = &payload[0];
+		iov[count++].iov_len = payload.size();
+	}
+
+	sendAll(_socket.impl()->sockfd(), iov, count);
+	return (int)length;
+#endif
+}
+
+int SIOFrameWriter::sendFrames(std::vector<std::string> &frames, const std::vector<int> &flags)
+{
+#ifdef SIO_NO_WRITEV
+	throw Poco::NotImplementedException("sendmsg");
+#else
+	//stay well below IOV_MAX, two buffers per frame
+	const std::size_t batch = 256;
+	std::vector<unsigned char> headers(batch * 14);
+	std::vector<struct iovec> iov(batch * 2);
+	int total = 0;
+
+	for(std::size_t first = 0; first < frames.size(); first += batch)
+	{
+		std::size_t last = first + batch < frames.size() ? first + batch : frames.size();
+		int count = 0;
+		for(std::size_t i = first; i < last; ++i)
+		{
+			unsigned char key[4];
+			newKey(key);
+			unsigned char *header = &headers[(i - first) * 14];
+			std::string &frame = frames[i];
+
+			iov[count].iov_base = header;
+			iov[count++].iov_len = writeHeader(header, flags[i], frame.size(), key);
+			if(!frame.empty())
+			{
+				mask(&frame[0], frame.size(), key, 0);
+				iov[count].iov_base = &frame[0];
+				iov[count++].iov_len = frame.size();
+			}
+			total += (int)frame.size();
+		}
+		sendAll(_socket.impl()->sockfd(), &iov[0], count);
+	}
+	return total;
+#endif
+}
@@ -0,0 +1,103 @@
+#include "SIOHistogram.h"
+
+SIOHistogram::SIOHistogram() :
+	_count(0),
+	_sum(0),
+	_max(0)
+{
+	for(int i = 0; i < BUCKETS; ++i)
+		_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+int SIOHistogram::bucketOf(Poco::UInt64 value)
+{
+	if(value < 2 * SUB_COUNT)
+		return (int)value;
+#if defined(__GNUC__)
+	int msb = 63 - __builtin_clzll(value);
+#else
+	int msb = 63;
+	while(!(value >> msb))
+		--msb;
+#endif
+	if(msb >= MAX_BITS)
+		return BUCKETS - 1;
+	//the top SUB_BITS + 1 bits of the value, scaled by its magnitude
+	int shift = msb - SUB_BITS;
+	return shift * SUB_COUNT + (int)(value >> shift);
+}
+
+Poco::UInt64 SIOHistogram::bucketValue(int bucket)
+{
+	if(bucket < 2 * SUB_COUNT)
+		return bucket;
+	int shift = bucket / SUB_COUNT - 1;
+	Poco::UInt64 sub = bucket - shift * SUB_COUNT;
+	return ((sub + 1) << shift) - 1;
+}
+
+void SIOHistogram::record(Poco::Int64 micros)
+{
+	Poco::UInt64 value = micros > 0 ? (Poco::UInt64)micros : 0;
+	_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(value, std::memory_order_relaxed);
+	Poco::UInt64 max = _max.load(std::memory_order_relaxed);
+	while(value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		;
+}
+
+void SIOHistogram::merge(const SIOHistogram &other)
+{
+	for(int i = 0; i < BUCKETS; ++i)
+	{
+		Poco::UInt64 n = other._buckets[i].load(std::memory_order_relaxed);
+		if(n > 0)
+			_buckets[i].fetch_add(n, std::memory_order_relaxed);
+	}
+	_count.fetch_add(other.count(), std::memory_order_relaxed);
+	_sum.fetch_add(other.sum(), std::memory_order_relaxed);
+	Poco::UInt64 value = other.max();
+	Poco::UInt64 max = _max.load(std::memory_order_relaxed);
+	while(value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		;
+}
+
+void SIOHistogram::reset()
+{
+	for(int i = 0; i < BUCKETS; ++i)
+		_buckets[i].store(0, std::memory_order_relaxed);
+	_count.store(0, std::memory_order_relaxed);
+	_sum.store(0, std::memory_order_relaxed);
+	_max.store(0, std::memory_order_relaxed);
+}
+
+Poco::UInt64 SIOHistogram::percentile(double percent) const
+{
+	//the buckets are summed rather than trusting _count, which may be
+	//ahead of them while other threads record
+	Poco::UInt64 total = 0;
+	for(int i = 0; i < BUCKETS; ++i)
+		total += _buckets[i].load(std::memory_order_relaxed);
+	if(total == 0)
+		return 0;
+
+	Poco::UInt64 rank = (Poco::UInt64)(percent / 100.0 * total + 0.5);
+	if(rank < 1)
+		rank = 1;
+	if(rank > total)
+		rank = total;
+	Poco::UInt64 seen = 0;
+	for(int i = 0; i < BUCKETS; ++i)
+	{
+		seen += _buckets[i].load(std::memory_order_relaxed);
+		if(seen >= rank)
+		{
+			//never above the largest value recorded
+			Poco::UInt64 value = bucketValue(i);
+			Poco::UInt64 max = this->max();
+			return max > 0 && value > max ? max : value;
+		}
+	}
+	return max();
+}
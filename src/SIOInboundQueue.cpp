@@ -0,0 +1,237 @@
+#include "SIOInboundQueue.h"
+#include "SIOPacket.h"
+
+SIOInboundQueue::SIOInboundQueue() :
+	_head(0),
+	_maxEvents((std::size_t)-1),
+	_maxBytes((std::size_t)-1),
+	_policy(SIOConfig::INBOUND_BLOCK),
+	_closed(false)
+{
+}
+
+SIOInboundQueue::~SIOInboundQueue()
+{
+	clear();
+}
+
+void SIOInboundQueue::setBudget(std::size_t maxEvents, std::size_t maxBytes, SIOConfig::InboundPolicy policy)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_maxEvents = maxEvents > 0 ? maxEvents : 1;
+	_maxBytes = maxBytes;
+	_policy = policy;
+	_space.broadcast();
+}
+
+bool SIOInboundQueue::full(std::size_t size) const
+{
+	//an event larger than the whole budget still gets through an empty queue
+	if(_stats.events == 0)
+		return false;
+	return _stats.events >= _maxEvents || _stats.bytes + size > _maxBytes;
+}
+
+SIOInboundQueue::Result SIOInboundQueue::push(const std::string &uri, SocketIOPacket *packet, std::size_t size,
+	const std::string &key, bool droppable)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if(!key.empty())
+	{
+		std::map<std::string, unsigned long long>::iterator it = _keyed.find(key);
+		if(it != _keyed.end())
+		{
+			//the handler has not seen the older value yet, it only gets the newest
+			Event &event = _events[it->second - _head];
+			delete event.packet;
+			event.packet = packet;
+			_stats.bytes = _stats.bytes - event.size + size;
+			event.size = size;
+			++_stats.coalesced;
+			queued();
+			return COALESCED;
+		}
+	}
+
+	bool waited = false;
+	while(!_closed && full(size))
+	{
+		switch(_policy)
+		{
+		case SIOConfig::INBOUND_DROP_OLDEST:
+			dropOldest();
+			continue;
+		case SIOConfig::INBOUND_DROP_EVENTS:
+			if(dropDroppable())
+				continue;
+			if(droppable)
+			{
+				delete packet;
+				++_stats.dropped;
+				return DROPPED;
+			}
+			break;//nothing may be dropped, wait like INBOUND_BLOCK
+		case SIOConfig::INBOUND_DISCONNECT:
+			delete packet;
+			++_stats.dropped;
+			return OVER_BUDGET;
+		case SIOConfig::INBOUND_BLOCK:
+			break;
+		}
+		if(!waited)
+			++_stats.blocked;
+		waited = true;
+		_space.wait(_mutex);
+	}
+
+	unsigned long long seq = _head + _events.size();
+	if(!key.empty())
+		_keyed[key] = seq;
+	if(droppable && _policy == SIOConfig::INBOUND_DROP_EVENTS)
+		_droppable.push_back(seq);
+	_events.push_back(Event());
+	_events.back().uri = uri;
+	_events.back().packet = packet;
+	_events.back().size = size;
+	_keys.push_back(key);
+	++_stats.events;
+	_stats.bytes += size;
+	queued();
+	_ready.signal();
+	return QUEUED;
+}
+
+void SIOInboundQueue::queued()
+{
+	if(_stats.events > _stats.highEvents)
+		_stats.highEvents = _stats.events;
+	if(_stats.bytes > _stats.highBytes)
+		_stats.highBytes = _stats.bytes;
+}
+
+void SIOInboundQueue::dropOldest()
+{
+	//only called with events queued, there is one behind the holes
+	while(!_events.front().packet)
+	{
+		_events.pop_front();
+		_keys.pop_front();
+		++_head;
+	}
+	Event &event = _events.front();
+	delete event.packet;
+	--_stats.events;
+	_stats.bytes -= event.size;
+	++_stats.dropped;
+	if(!_keys.front().empty())
+		_keyed.erase(_keys.front());
+	_events.pop_front();
+	_keys.pop_front();
+	++_head;
+}
+
+bool SIOInboundQueue::dropDroppable()
+{
+	while(!_droppable.empty())
+	{
+		unsigned long long seq = _droppable.front();
+		_droppable.pop_front();
+		if(seq < _head)
+			continue;//delivered already
+		Event &event = _events[seq - _head];
+		if(!event.packet)
+			continue;
+
+		//leave a hole, the sequence numbers of the events behind stay valid
+		delete event.packet;
+		event.packet = NULL;
+		--_stats.events;
+		_stats.bytes -= event.size;
+		++_stats.dropped;
+		std::string &key = _keys[seq - _head];
+		if(!key.empty())
+		{
+			_keyed.erase(key);
+			key.clear();
+		}
+		return true;
+	}
+	return false;
+}
+
+bool SIOInboundQueue::pop(Event &event)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	for(;;)
+	{
+		while(_events.empty())
+		{
+			if(_closed)
+				return false;
+			_ready.wait(_mutex);
+		}
+
+		Event &front = _events.front();
+		bool hole = !front.packet;
+		event.uri.swap(front.uri);
+		event.packet = front.packet;
+		event.size = front.size;
+		_events.pop_front();
+		if(!_keys.front().empty())
+			_keyed.erase(_keys.front());
+		_keys.pop_front();
+		++_head;
+		while(!_droppable.empty() && _droppable.front() < _head)
+			_droppable.pop_front();
+		if(hole)
+			continue;
+
+		--_stats.events;
+		_stats.bytes -= event.size;
+		_space.signal();
+		return true;
+	}
+}
+
+void SIOInboundQueue::close()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_closed = true;
+	_ready.broadcast();
+	_space.broadcast();
+}
+
+std::size_t SIOInboundQueue::clear()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	std::size_t dropped = _stats.events;
+	for(std::deque<Event>::iterator it = _events.begin(); it != _events.end(); ++it)
+		delete it->packet;
+	_head += _events.size();
+	_events.clear();
+	_keys.clear();
+	_keyed.clear();
+	_droppable.clear();
+	_stats.events = 0;
+	_stats.bytes = 0;
+	_space.broadcast();
+	return dropped;
+}
+
+std::size_t SIOInboundQueue::events()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _stats.events;
+}
+
+std::size_t SIOInboundQueue::coalesced()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _stats.coalesced;
+}
+
+SIOInboundQueue::Stats SIOInboundQueue::stats()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _stats;
+}
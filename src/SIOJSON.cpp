@@ -0,0 +1,550 @@
+#include "SIOJSON.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "Poco/Exception.h"
+#include "Poco/JSON/Parser.h"
+#include "Poco/JSON/ParseHandler.h"
+
+using Poco::JSON::Parser;
+using Poco::JSON::ParseHandler;
+using Poco::Dynamic::Var;
+using Poco::JSON::Array;
+using Poco::JSON::Object;
+
+// Poco backend
+
+bool SIOJSONPoco::parseHandshake(const std::string &payload, SIOHandshake &out)
+{
+	try
+	{
+		ParseHandler::Ptr pHandler = new ParseHandler(false);
+		Parser parser(pHandler);
+		Var result = parser.parse(payload);
+		Object::Ptr msg = result.extract<Object::Ptr>();
+
+		out.sid = msg->get("sid").toString();
+		out.pingInterval = atoi(msg->get("pingInterval").toString().c_str());
+		out.pingTimeout = atoi(msg->get("pingTimeout").toString().c_str());
+	}
+	catch(Poco::Exception &e)
+	{
+		return false;
+	}
+	return true;
+}
+
+bool SIOJSONPoco::parseEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet)
+{
+	try
+	{
+		ParseHandler::Ptr pHandler = new ParseHandler(false);
+		Parser parser(pHandler);
+		Var result = parser.parse(payload);
+
+		switch(version)
+		{
+			case SocketIOPacket::V09x:
+			{
+				Object::Ptr msg = result.extract<Object::Ptr>();
+				packet->setEvent(msg->get("name").toString());
+				Array::Ptr args = msg->getArray("args");
+				if(!args.isNull())
+					packet->addData(args);
+			}	break;
+			case SocketIOPacket::V10x:
+			{
+				Array::Ptr msg = result.extract<Array::Ptr>();
+				if(msg->size() == 0)
+					return false;
+				packet->setEvent(msg->get(0).toString());
+				for(std::size_t i = 1; i < msg->size() ; ++i)
+					packet->addData(msg->get(i).toString());
+			}	break;
+		}
+	}
+	catch(Poco::Exception &e)
+	{
+		return false;
+	}
+	return true;
+}
+
+bool SIOJSONPoco::parseConnect(const std::string &payload, std::string &sid, std::string &pid)
+{
+	try
+	{
+		ParseHandler::Ptr pHandler = new ParseHandler(false);
+		Parser parser(pHandler);
+		Var result = parser.parse(payload);
+		Object::Ptr msg = result.extract<Object::Ptr>();
+
+		sid = msg->get("sid").toString();
+		pid.clear();
+		if(msg->has("pid"))
+			pid = msg->get("pid").toString();
+	}
+	catch(Poco::Exception &e)
+	{
+		return false;
+	}
+	return true;
+}
+
+bool SIOJSONPoco::parseOffset(const std::string &payload, std::string &offset)
+{
+	try
+	{
+		ParseHandler::Ptr pHandler = new ParseHandler(false);
+		Parser parser(pHandler);
+		Var result = parser.parse(payload);
+		Array::Ptr msg = result.extract<Array::Ptr>();
+		if(msg->size() < 2)
+			return false;
+		Var last = msg->get(msg->size() - 1);
+		if(!last.isString())
+			return false;
+		offset = last.toString();
+	}
+	catch(Poco::Exception &e)
+	{
+		return false;
+	}
+	return true;
+}
+
+// Scanner backend
+
+const char *SIOJSONScanner::skipWhitespace(const char *p, const char *end)
+{
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		++p;
+	return p;
+}
+
+static const char *skipString(const char *p, const char *end)
+{
+	for(++p; p < end; ++p)
+	{
+		if(*p == '\\')
+			++p;
+		else if(*p == '"')
+			return p + 1;
+	}
+	return NULL;
+}
+
+const char *SIOJSONScanner::skipValue(const char *p, const char *end)
+{
+	if(p >= end)
+		return NULL;
+
+	if(*p == '"')
+		return skipString(p, end);
+
+	if(*p == '{' || *p == '[')
+	{
+		int depth = 0;
+		while(p < end)
+		{
+			switch(*p)
+			{
+				case '"':
+					p = skipString(p, end);
+					if(!p)
+						return NULL;
+					continue;
+				case '{':
+				case '[':
+					++depth;
+					break;
+				case '}':
+				case ']':
+					if(--depth == 0)
+						return p + 1;
+					break;
+			}
+			++p;
+		}
+		return NULL;
+	}
+
+	//number, true, false or null
+	const char *start = p;
+	while(p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+		++p;
+	return p == start ? NULL : p;
+}
+
+static int hexValue(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static bool readHex4(const char *p, const char *end, unsigned int &out)
+{
+	if(end - p < 4)
+		return false;
+	out = 0;
+	for(int i = 0; i < 4; ++i)
+	{
+		int v = hexValue(p[i]);
+		if(v < 0)
+			return false;
+		out = (out << 4) | v;
+	}
+	return true;
+}
+
+static void appendUTF8(std::string &out, unsigned int cp)
+{
+	if(cp < 0x80)
+		out += (char)cp;
+	else if(cp < 0x800)
+	{
+		out += (char)(0xC0 | (cp >> 6));
+		out += (char)(0x80 | (cp & 0x3F));
+	}
+	else if(cp < 0x10000)
+	{
+		out += (char)(0xE0 | (cp >> 12));
+		out += (char)(0x80 | ((cp >> 6) & 0x3F));
+		out += (char)(0x80 | (cp & 0x3F));
+	}
+	else
+	{
+		out += (char)(0xF0 | (cp >> 18));
+		out += (char)(0x80 | ((cp >> 12) & 0x3F));
+		out += (char)(0x80 | ((cp >> 6) & 0x3F));
+		out += (char)(0x80 | (cp & 0x3F));
+	}
+}
+
+const char *SIOJSONScanner::readString(const char *p, const char *end, std::string &out)
+{
+	out.clear();
+	if(p >= end || *p != '"')
+		return NULL;
+	++p;
+	while(p < end)
+	{
+		//copy the run up to the next quote or escape in one go
+		const char *run = p;
+		while(p < end && *p != '"' && *p != '\\')
+			++p;
+		out.append(run, p - run);
+		if(p >= end)
+			return NULL;
+		if(*p == '"')
+			return p + 1;
+
+		//escape sequence
+		if(++p >= end)
+			return NULL;
+		switch(*p)
+		{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				unsigned int cp;
+				if(!readHex4(p + 1, end, cp))
+					return NULL;
+				p += 4;
+				if(cp >= 0xD800 && cp <= 0xDBFF)
+				{//surrogate pair
+					unsigned int low;
+					if(end - p < 7 || p[1] != '\\' || p[2] != 'u' || !readHex4(p + 3, end, low) || low < 0xDC00 || low > 0xDFFF)
+						return NULL;
+					p += 6;
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUTF8(out, cp);
+			}	break;
+			default:
+				return NULL;
+		}
+		++p;
+	}
+	return NULL;
+}
+
+//adds a value that is not a string the way the Poco backend does, so that
+//handlers get the same arguments whichever backend is built: V09x keeps the
+//parsed value (Object::Ptr, Array::Ptr, number), V10x the text Poco writes.
+//This builds a Poco::JSON DOM of the value, objects included.
+static bool addParsed(const char *p, const char *end, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet)
+{
+	try
+	{
+		ParseHandler::Ptr pHandler = new ParseHandler(false);
+		Parser parser(pHandler);
+		Array::Ptr value;
+		if(*p == '{' || *p == '[')
+		{
+			value = new Array();
+			value->add(parser.parse(std::string(p, end - p)));
+		}
+		else
+		{
+			//wrapped, older Poco parsers only take an object or an array
+			value = parser.parse("[" + std::string(p, end - p) + "]").extract<Array::Ptr>();
+			if(value->size() != 1)
+				return false;
+		}
+		if(version == SocketIOPacket::V09x)
+			packet->addData(value);
+		else
+			packet->addData(value->get(0).toString());
+	}
+	catch(Poco::Exception &e)
+	{
+		return false;
+	}
+	return true;
+}
+
+//reads the elements of an array, p is after the opening bracket (or after the
+//elements that have been consumed already) and the first element is preceded
+//by a comma when leadingComma is set
+static const char *readArgs(const char *p, const char *end, bool leadingComma, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet)
+{
+	std::string arg;
+	bool first = !leadingComma;
+	while(true)
+	{
+		p = SIOJSONScanner::skipWhitespace(p, end);
+		if(p >= end)
+			return NULL;
+		if(*p == ']')
+			return p + 1;
+		if(!first)
+		{
+			if(*p != ',')
+				return NULL;
+			p = SIOJSONScanner::skipWhitespace(p + 1, end);
+		}
+		first = false;
+
+		if(p < end && *p == '"')
+		{
+			p = SIOJSONScanner::readString(p, end, arg);
+			if(!p)
+				return NULL;
+			packet->addData(arg);
+		}
+		else
+		{
+			const char *e = SIOJSONScanner::skipValue(p, end);
+			if(!e || !addParsed(p, e, version, packet))
+				return NULL;
+			p = e;
+		}
+	}
+}
+
+bool SIOJSONScanner::parseHandshake(const std::string &payload, SIOHandshake &out)
+{
+	const char *p = payload.data();
+	const char *end = p + payload.size();
+	bool hasSid = false;
+	std::string key;
+
+	p = skipWhitespace(p, end);
+	if(p >= end || *p != '{')
+		return false;
+	++p;
+	while(true)
+	{
+		p = skipWhitespace(p, end);
+		if(p >= end)
+			return false;
+		if(*p == '}')
+			break;
+
+		p = readString(p, end, key);
+		if(!p)
+			return false;
+		p = skipWhitespace(p, end);
+		if(p >= end || *p != ':')
+			return false;
+		p = skipWhitespace(p + 1, end);
+
+		if(key == "sid")
+		{
+			p = readString(p, end, out.sid);
+			hasSid = true;
+		}
+		else
+		{
+			const char *e = skipValue(p, end);
+			if(e && key == "pingInterval")
+				out.pingInterval = atoi(std::string(p, e - p).c_str());
+			else if(e && key == "pingTimeout")
+				out.pingTimeout = atoi(std::string(p, e - p).c_str());
+			p = e;
+		}
+		if(!p)
+			return false;
+
+		p = skipWhitespace(p, end);
+		if(p < end && *p == ',')
+			++p;
+	}
+	return hasSid;
+}
+
+bool SIOJSONScanner::parseEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version, SocketIOPacket *packet)
+{
+	const char *p = payload.data();
+	const char *end = p + payload.size();
+	std::string value;
+
+	p = skipWhitespace(p, end);
+	switch(version)
+	{
+		case SocketIOPacket::V09x:
+		{
+			if(p >= end || *p != '{')
+				return false;
+			++p;
+			while(true)
+			{
+				p = skipWhitespace(p, end);
+				if(p >= end)
+					return false;
+				if(*p == '}')
+					break;
+
+				std::string key;
+				p = readString(p, end, key);
+				if(!p)
+					return false;
+				p = skipWhitespace(p, end);
+				if(p >= end || *p != ':')
+					return false;
+				p = skipWhitespace(p + 1, end);
+
+				if(key == "name")
+				{
+					p = readString(p, end, value);
+					packet->setEvent(value);
+				}
+				else if(key == "args" && p < end && *p == '[')
+					p = readArgs(p + 1, end, false, version, packet);
+				else
+					p = skipValue(p, end);
+				if(!p)
+					return false;
+
+				p = skipWhitespace(p, end);
+				if(p < end && *p == ',')
+					++p;
+			}
+		}	break;
+		case SocketIOPacket::V10x:
+		{
+			if(p >= end || *p != '[')
+				return false;
+			p = skipWhitespace(p + 1, end);
+			p = readString(p, end, value);
+			if(!p)
+				return false;
+			packet->setEvent(value);
+			if(!readArgs(p, end, true, version, packet))
+				return false;
+		}	break;
+	}
+	return true;
+}
+
+bool SIOJSONScanner::parseConnect(const std::string &payload, std::string &sid, std::string &pid)
+{
+	const char *p = payload.data();
+	const char *end = p + payload.size();
+	bool hasSid = false;
+	std::string key;
+
+	pid.clear();
+	p = skipWhitespace(p, end);
+	if(p >= end || *p != '{')
+		return false;
+	++p;
+	while(true)
+	{
+		p = skipWhitespace(p, end);
+		if(p >= end)
+			return false;
+		if(*p == '}')
+			break;
+
+		p = readString(p, end, key);
+		if(!p)
+			return false;
+		p = skipWhitespace(p, end);
+		if(p >= end || *p != ':')
+			return false;
+		p = skipWhitespace(p + 1, end);
+
+		if(key == "sid")
+		{
+			p = readString(p, end, sid);
+			hasSid = true;
+		}
+		else if(key == "pid" && p < end && *p == '"')
+			p = readString(p, end, pid);
+		else
+			p = skipValue(p, end);
+		if(!p)
+			return false;
+
+		p = skipWhitespace(p, end);
+		if(p < end && *p == ',')
+			++p;
+	}
+	return hasSid;
+}
+
+bool SIOJSONScanner::parseOffset(const std::string &payload, std::string &offset)
+{
+	const char *p = payload.data();
+	const char *end = p + payload.size();
+	const char *last = NULL;
+	int count = 0;
+
+	p = skipWhitespace(p, end);
+	if(p >= end || *p != '[')
+		return false;
+	++p;
+	while(true)
+	{
+		p = skipWhitespace(p, end);
+		if(p >= end)
+			return false;
+		if(*p == ']')
+			break;
+
+		last = p;
+		++count;
+		p = skipValue(p, end);
+		if(!p)
+			return false;
+
+		p = skipWhitespace(p, end);
+		if(p < end && *p == ',')
+			++p;
+	}
+	if(count < 2 || *last != '"')
+		return false;
+	return readString(last, end, offset) != NULL;
+}
@@ -0,0 +1,100 @@
+#include "SIOLatency.h"
+#include "SIOMetrics.h"
+
+namespace
+{
+	static Poco::SingletonHolder<SIOLatency> sh;
+
+	static SIOHistogram &stageOf(SIOEventLatency &latency, SIOLatency::Stage stage)
+	{
+		switch(stage)
+		{
+		case SIOLatency::DECODE: return latency.decode;
+		case SIOLatency::QUEUE: return latency.queue;
+		case SIOLatency::HANDLER: return latency.handler;
+		default: return latency.total;
+		}
+	}
+}
+
+const char *SIOLatency::OTHER = "(other)";
+
+SIOLatency *SIOLatency::instance()
+{
+	return sh.get();
+}
+
+SIOLatency::~SIOLatency()
+{
+	for(std::map<std::string, SIOEventLatency *>::iterator it = _events.begin(); it != _events.end(); ++it)
+		delete it->second;
+}
+
+SIOEventLatency *SIOLatency::get(const std::string &name)
+{
+	{
+		Poco::ScopedReadRWLock lock(_lock);
+		std::map<std::string, SIOEventLatency *>::iterator it = _events.find(name);
+		if(it != _events.end())
+			return it->second;
+	}
+
+	Poco::ScopedWriteRWLock lock(_lock);
+	std::string key = _events.size() < MAX_EVENTS ? name : std::string(OTHER);
+	SIOEventLatency *&latency = _events[key];
+	if(!latency)
+		latency = new SIOEventLatency;
+	return latency;
+}
+
+void SIOLatency::names(std::vector<std::string> &names)
+{
+	Poco::ScopedReadRWLock lock(_lock);
+	for(std::map<std::string, SIOEventLatency *>::iterator it = _events.begin(); it != _events.end(); ++it)
+		names.push_back(it->first);
+}
+
+bool SIOLatency::collect(const std::string &name, Stage stage, SIOHistogram &histogram)
+{
+	Poco::ScopedReadRWLock lock(_lock);
+	std::map<std::string, SIOEventLatency *>::iterator it = _events.find(name);
+	if(it == _events.end())
+		return false;
+	histogram.merge(stageOf(*it->second, stage));
+	return true;
+}
+
+void SIOLatency::reset()
+{
+	Poco::ScopedReadRWLock lock(_lock);
+	for(std::map<std::string, SIOEventLatency *>::iterator it = _events.begin(); it != _events.end(); ++it)
+	{
+		it->second->decode.reset();
+		it->second->queue.reset();
+		it->second->handler.reset();
+		it->second->total.reset();
+	}
+}
+
+void SIOLatency::collectMetrics(SIOMetricsSnapshot &snapshot)
+{
+	static const char *stages[] = {"decode", "queue", "handler", "total"};
+	static const double quantiles[] = {50, 99, 99.9};
+	static const char *labels[] = {"0.5", "0.99", "0.999"};
+	static const char *name = "sio_event_latency_seconds";
+	static const char *help = "Time received events spent in each stage, per event name.";
+
+	Poco::ScopedReadRWLock lock(_lock);
+	for(std::map<std::string, SIOEventLatency *>::iterator it = _events.begin(); it != _events.end(); ++it)
+	{
+		for(int s = DECODE; s <= TOTAL; ++s)
+		{
+			SIOHistogram &histogram = stageOf(*it->second, (Stage)s);
+			std::string base = "event=" + SIOMetricsSnapshot::quote(it->first) + ",stage=\"" + stages[s] + "\"";
+			for(int q = 0; q < 3; ++q)
+				snapshot.add(name, "summary", help, base + ",quantile=\"" + labels[q] + "\"", histogram.percentile(quantiles[q]) / 1e6);
+			snapshot.add(name, "summary", help, base, histogram.sum() / 1e6, "_sum");
+			snapshot.add(name, "summary", help, base, (double)histogram.count(), "_count");
+		}
+	}
+}
@@ -0,0 +1,156 @@
+#include "SIOMetrics.h"
+#include "SIOClientImpl.h"
+#include "SIOLatency.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+namespace
+{
+	static Poco::SingletonHolder<SIOMetrics> sh;
+}
+
+SIOCounter *SIOConnectionMetrics::eventCounter(const std::string &endpoint, const std::string &name)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	//map nodes do not move, the counter stays where it is
+	return &_events[std::make_pair(endpoint, name)];
+}
+
+SIOConnectionMetrics::SIOConnectionMetrics()
+{
+	for(std::size_t i = 0; i < EMIT_SLOTS; ++i)
+		_emitSlots[i].store(NULL, std::memory_order_relaxed);
+}
+
+SIOEmitCounter *SIOConnectionMetrics::emitCounter(const std::string &endpoint)
+{
+	std::size_t hash = std::hash<std::string>()(endpoint);
+	for(std::size_t i = 0; i < EMIT_SLOTS; ++i)
+	{
+		EmitMap::value_type *slot = _emitSlots[(hash + i) % EMIT_SLOTS].load(std::memory_order_acquire);
+		if(!slot)
+			break;
+		if(slot->first == endpoint)
+			return &slot->second;
+	}
+
+	//first emit of the namespace, or more namespaces than slots
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	EmitMap::iterator it = _emits.find(endpoint);
+	if(it != _emits.end())
+		return &it->second;
+	//built in place, atomics cannot be copied into the map
+	_emits[endpoint];
+	it = _emits.find(endpoint);
+	for(std::size_t i = 0; i < EMIT_SLOTS; ++i)
+	{
+		std::atomic<EmitMap::value_type *> &slot = _emitSlots[(hash + i) % EMIT_SLOTS];
+		if(!slot.load(std::memory_order_relaxed))
+		{
+			slot.store(&*it, std::memory_order_release);
+			break;
+		}
+	}
+	return &it->second;
+}
+
+void SIOConnectionMetrics::events(std::map<std::pair<std::string, std::string>, Poco::UInt64> &events)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	for(std::map<std::pair<std::string, std::string>, SIOCounter>::iterator it = _events.begin(); it != _events.end(); ++it)
+		events[it->first] = it->second.get();
+}
+
+void SIOConnectionMetrics::emits(std::map<std::string, std::pair<Poco::UInt64, Poco::UInt64> > &emits)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	for(EmitMap::iterator it = _emits.begin(); it != _emits.end(); ++it)
+		emits[it->first] = std::make_pair(it->second.count.get(), it->second.bytes.get());
+}
+
+void SIOMetricsSnapshot::add(const char *name, const char *type, const char *help, const std::string &labels, double value, const char *suffix)
+{
+	std::map<std::string, Family>::iterator it = _families.find(name);
+	if(it == _families.end())
+	{
+		_order.push_back(name);
+		it = _families.insert(std::make_pair(std::string(name), Family())).first;
+		it->second.type = type;
+		it->second.help = help;
+	}
+	Sample sample;
+	sample.suffix = suffix;
+	sample.labels = labels;
+	sample.value = value;
+	it->second.samples.push_back(sample);
+}
+
+std::string SIOMetricsSnapshot::quote(const std::string &value)
+{
+	std::string quoted = "\"";
+	for(std::size_t i = 0; i < value.size(); ++i)
+	{
+		switch(value[i])
+		{
+		case '\\': quoted += "\\\\"; break;
+		case '"': quoted += "\\\""; break;
+		case '\n': quoted += "\\n"; break;
+		default: quoted += value[i];
+		}
+	}
+	return quoted + "\"";
+}
+
+std::string SIOMetricsSnapshot::renderPrometheus() const
+{
+	std::string out;
+	char number[32];
+	for(std::size_t i = 0; i < _order.size(); ++i)
+	{
+		const Family &family = _families.find(_order[i])->second;
+		out += "# HELP " + _order[i] + " " + family.help + "\n";
+		out += "# TYPE " + _order[i] + " " + family.type + "\n";
+		for(std::size_t j = 0; j < family.samples.size(); ++j)
+		{
+			const Sample &sample = family.samples[j];
+			snprintf(number, sizeof(number), "%.17g", sample.value);
+			out += _order[i] + sample.suffix;
+			if(!sample.labels.empty())
+				out += "{" + sample.labels + "}";
+			out += std::string(" ") + number + "\n";
+		}
+	}
+	return out;
+}
+
+SIOMetrics *SIOMetrics::instance()
+{
+	return sh.get();
+}
+
+void SIOMetrics::addSocket(SIOClientImpl *socket)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_sockets.push_back(socket);
+}
+
+void SIOMetrics::removeSocket(SIOClientImpl *socket)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_sockets.erase(std::remove(_sockets.begin(), _sockets.end(), socket), _sockets.end());
+}
+
+std::string SIOMetrics::renderPrometheus()
+{
+	SIOMetricsSnapshot snapshot;
+	{
+		//sockets cannot go away while they are collected
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		for(std::size_t i = 0; i < _sockets.size(); ++i)
+			_sockets[i]->collectMetrics(snapshot);
+	}
+	SIOLatency::instance()->collectMetrics(snapshot);
+	return snapshot.renderPrometheus();
+}
@@ -7,6 +7,8 @@
 
 #include "SIOEventRegistry.h"
 #include "SIOClient.h"
+#include "SIOLog.h"
+#include "SIOLatency.h"
 
 using Poco::Observer;
 using Poco::JSON::Parser;
@@ -59,12 +61,19 @@ SIONotificationHandler::~SIONotificationHandler(void)
 
 void SIONotificationHandler::handleEvent(SIOEvent* pNf)
 {
-	_logger->information("handling Event");
-	_logger->information("data: %s", pNf->data->toString());
+	SIO_LOG_DEBUG(_logger, "handling Event");
+	SIO_LOG_DEBUG(_logger, "data: %s", SIOLogPayload(pNf->data->toString()));
 
 
+	SIOEventLatency *latency = pNf->data->getLatency();
+	if(latency)
+		latency->queue.record(Poco::Timestamp().epochMicroseconds() - pNf->data->getDispatched());
+
 	Poco::JSON::Array::Ptr arr = new Poco::JSON::Array(pNf->data->getDatas());
 	pNf->client->fireEvent(pNf->data->getEvent().c_str(),arr);
+
+	if(latency)
+		latency->total.record(Poco::Timestamp().epochMicroseconds() - pNf->data->getReceived());
 	pNf->release();
 }
 
@@ -0,0 +1,152 @@
+#include "SIOOutboundBuffer.h"
+
+SIOOutboundBuffer::SIOOutboundBuffer() :
+	_bytes(0),
+	_maxMessages(0),
+	_maxBytes(0),
+	_policy(SIOConfig::BUFFER_DROP_OLDEST),
+	_dropped(0),
+	_rejected(0),
+	_coalesced(0)
+{
+}
+
+void SIOOutboundBuffer::setLimits(std::size_t maxMessages, std::size_t maxBytes, SIOConfig::BufferPolicy policy)
+{
+	_maxMessages = maxMessages;
+	_maxBytes = maxBytes;
+	_policy = policy;
+
+	while(!_frames.empty() && (_frames.size() > _maxMessages || _bytes > _maxBytes))
+		dropOldest();
+}
+
+bool SIOOutboundBuffer::push(const std::string &endpoint, const std::string &frame, const std::string &key)
+{
+	if(_maxMessages == 0 || frame.size() > _maxBytes)
+	{
+		++_rejected;
+		return false;
+	}
+
+	if(!key.empty())
+	{
+		for(std::deque<Frame>::iterator it = _frames.begin(); it != _frames.end(); ++it)
+		{
+			if(it->key != key)
+				continue;
+			_bytes = _bytes - it->data.size() + frame.size();
+			it->data = frame;
+			++_coalesced;
+			//a larger value may push the buffer over its size
+			while(_bytes > _maxBytes && _frames.size() > 1)
+				dropOldest();
+			return true;
+		}
+	}
+
+	bool full = _frames.size() >= _maxMessages || _bytes + frame.size() > _maxBytes;
+	if(full)
+	{
+		switch(_policy)
+		{
+		case SIOConfig::BUFFER_DROP_OLDEST:
+			while(_frames.size() >= _maxMessages || _bytes + frame.size() > _maxBytes)
+				dropOldest();
+			break;
+		case SIOConfig::BUFFER_DROP_NEWEST:
+			++_dropped;
+			return true;
+		case SIOConfig::BUFFER_REJECT:
+			++_rejected;
+			return false;
+		}
+	}
+
+	_frames.push_back(Frame());
+	_frames.back().endpoint = endpoint;
+	_frames.back().data = frame;
+	_frames.back().key = key;
+	_bytes += frame.size();
+	++_perEndpoint[endpoint];
+	return true;
+}
+
+void SIOOutboundBuffer::append(const std::string &endpoint, std::vector<std::string> &frames)
+{
+	for(std::size_t i = 0; i < frames.size(); ++i)
+	{
+		_frames.push_back(Frame());
+		_frames.back().endpoint = endpoint;
+		_frames.back().data.swap(frames[i]);
+		_bytes += _frames.back().data.size();
+	}
+	if(!frames.empty())
+		_perEndpoint[endpoint] += frames.size();
+}
+
+void SIOOutboundBuffer::take(const std::string &endpoint, std::vector<std::string> &frames, std::size_t max)
+{
+	std::map<std::string, std::size_t>::iterator pending = _perEndpoint.find(endpoint);
+	if(pending == _perEndpoint.end() || max == 0)
+		return;
+	if(pending->second <= max)
+		_perEndpoint.erase(pending);
+	else
+		pending->second -= max;
+
+	std::size_t taken = 0;
+	std::deque<Frame> rest;
+	for(std::deque<Frame>::iterator it = _frames.begin(); it != _frames.end(); ++it)
+	{
+		if(it->endpoint == endpoint && taken < max)
+		{
+			++taken;
+			_bytes -= it->data.size();
+			frames.push_back(std::string());
+			frames.back().swap(it->data);
+		}
+		else
+		{
+			rest.push_back(Frame());
+			rest.back().endpoint.swap(it->endpoint);
+			rest.back().data.swap(it->data);
+			rest.back().key.swap(it->key);
+		}
+	}
+	_frames.swap(rest);
+}
+
+bool SIOOutboundBuffer::has(const std::string &endpoint) const
+{
+	return _perEndpoint.find(endpoint) != _perEndpoint.end();
+}
+
+std::size_t SIOOutboundBuffer::count(const std::string &endpoint) const
+{
+	std::map<std::string, std::size_t>::const_iterator it = _perEndpoint.find(endpoint);
+	return it != _perEndpoint.end() ? it->second : 0;
+}
+
+void SIOOutboundBuffer::endpoints(std::vector<std::string> &endpoints) const
+{
+	for(std::map<std::string, std::size_t>::const_iterator it = _perEndpoint.begin(); it != _perEndpoint.end(); ++it)
+		endpoints.push_back(it->first);
+}
+
+void SIOOutboundBuffer::clear()
+{
+	_frames.clear();
+	_perEndpoint.clear();
+	_bytes = 0;
+}
+
+void SIOOutboundBuffer::dropOldest()
+{
+	std::map<std::string, std::size_t>::iterator it = _perEndpoint.find(_frames.front().endpoint);
+	if(--it->second == 0)
+		_perEndpoint.erase(it);
+	_bytes -= _frames.front().data.size();
+	_frames.pop_front();
+	++_dropped;
+}
@@ -12,6 +12,10 @@ SocketIOPacket::SocketIOPacket()
 	_ack = "";//
 	_name = "";//event name
 	_endpoint = "";//
+	_volatile = false;
+	_latency = NULL;
+	_received = 0;
+	_dispatched = 0;
 	_types.push_back("disconnect");
 	_types.push_back("connect");
 	_types.push_back("heartbeat");
@@ -44,6 +48,13 @@ void SocketIOPacket::initWithTypeIndex(int index)
 }
 
 std::string SocketIOPacket::toString()
+{
+	std::string prefix, payload;
+	encode(prefix, payload);
+	return prefix + payload;
+}
+
+void SocketIOPacket::encode(std::string &prefix, std::string &payload)
 {
 	std::stringstream encoded;
 	encoded << this->typeAsNumber();
@@ -68,18 +79,19 @@ std::string SocketIOPacket::toString()
 		encoded << _endpoint;
 	encoded << this->_separator;
 
+	payload.clear();
 	if (_args.size() != 0)
 	{
-		std::string ackpId = "";
 		// This is an acknowledgement packet, so, prepend the ack pid to the data
 		if (_type == "ack")
 		{
-			ackpId += pIdL+"+";
+			encoded << pIdL << "+";
 		}
-		encoded << ackpId << this->stringify();
+		payload = this->stringify();
 	}
-	return encoded.str();
+	prefix = encoded.str();
 }
+
 int SocketIOPacket::typeAsNumber()
 {
 	int num = 0;
@@ -178,11 +190,36 @@ int SocketIOPacketV10x::typeAsNumber()
     return num;
 }
 
+void SocketIOPacketV10x::encode(std::string &prefix, std::string &payload)
+{
+	std::stringstream encoded;
+	int type = this->typeAsNumber();
+	encoded << type;
+
+	//events always carry at least their name, acks their arguments
+	bool hasData = _type == "event" || _type == "ack" || _args.size() != 0;
+
+	//engine.io packets (below 40) have no namespace, the default one is implicit
+	if(type >= 40 && !_endpoint.empty() && _endpoint != "/")
+	{
+		encoded << _endpoint;
+		if(hasData || !_pId.empty())
+			encoded << ",";
+	}
+	encoded << _pId;
+
+	payload.clear();
+	if(hasData)
+		payload = this->stringify();
+	prefix = encoded.str();
+}
+
 std::string SocketIOPacketV10x::stringify()
 {
 	std::stringstream ss;
 	Poco::JSON::Array data;
-	data.add(_name);
+	if(_type != "ack")
+		data.add(_name);
 	for(int i = 0 ; i<_args.size();++i)
 		data.add(_args.get(i));
 	data.stringify(ss);
@@ -0,0 +1,40 @@
+#include "SIORateLimiter.h"
+
+SIORateLimiter::SIORateLimiter() :
+	_rate(0),
+	_burst(0),
+	_tokens(0),
+	_throttled(0),
+	_dropped(0)
+{
+}
+
+void SIORateLimiter::setRate(double rate, double burst)
+{
+	_rate = rate > 0 ? rate : 0;
+	_burst = burst > 0 ? burst : _rate;
+	if(_burst < 1)
+		_burst = 1;
+	//start full, a namespace may send its burst right away
+	_tokens = _burst;
+	_last.update();
+}
+
+void SIORateLimiter::refill()
+{
+	Poco::Timestamp now;
+	_tokens += (now - _last) * _rate / 1000000.0;
+	if(_tokens > _burst)
+		_tokens = _burst;
+	_last = now;
+}
+
+std::size_t SIORateLimiter::take(std::size_t wanted)
+{
+	if(!enabled())
+		return wanted;
+	refill();
+	std::size_t granted = _tokens >= wanted ? wanted : (std::size_t)_tokens;
+	_tokens -= granted;
+	return granted;
+}
@@ -0,0 +1,55 @@
+#include "SIORttStats.h"
+
+#include <algorithm>
+
+SIORttStats::SIORttStats(std::size_t capacity) :
+	_capacity(capacity > 0 ? capacity : 1),
+	_next(0),
+	_last(0)
+{
+	_samples.reserve(_capacity);
+}
+
+void SIORttStats::add(Poco::Timestamp::TimeDiff rtt)
+{
+	_last = rtt;
+	if(_samples.size() < _capacity)
+		_samples.push_back(rtt);
+	else
+	{
+		_samples[_next] = rtt;
+		_next = (_next + 1) % _capacity;
+	}
+}
+
+Poco::Timestamp::TimeDiff SIORttStats::min() const
+{
+	if(_samples.empty())
+		return 0;
+	return *std::min_element(_samples.begin(), _samples.end());
+}
+
+Poco::Timestamp::TimeDiff SIORttStats::avg() const
+{
+	if(_samples.empty())
+		return 0;
+	Poco::Timestamp::TimeDiff sum = 0;
+	for(std::size_t i = 0; i < _samples.size(); ++i)
+		sum += _samples[i];
+	return sum / (Poco::Timestamp::TimeDiff)_samples.size();
+}
+
+Poco::Timestamp::TimeDiff SIORttStats::percentile(double percent) const
+{
+	if(_samples.empty())
+		return 0;
+	//nearest rank on a copy, the ring stays in arrival order
+	std::vector<Poco::Timestamp::TimeDiff> sorted(_samples);
+	std::size_t rank = (std::size_t)(percent / 100.0 * sorted.size() + 0.999999);
+	if(rank < 1)
+		rank = 1;
+	if(rank > sorted.size())
+		rank = sorted.size();
+	std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+	return sorted[rank - 1];
+}
@@ -0,0 +1,201 @@
+#include "SIOSendQueue.h"
+
+#include "Poco/Timestamp.h"
+
+SIOSendQueue::SIOSendQueue() :
+	_bulkHead(0),
+	_coalesced(0),
+	_bytes(0),
+	_closed(false),
+	_high((std::size_t)-1),
+	_low(0),
+	_max((std::size_t)-1),
+	_full(false),
+	_drained(false)
+{
+}
+
+void SIOSendQueue::push(Lane lane, std::string &prefix, std::string &payload, const std::string &key)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if(lane == LANE_BULK)
+	{
+		if(!key.empty())
+		{
+			std::map<std::string, unsigned long long>::iterator it = _keyed.find(key);
+			if(it != _keyed.end())
+			{
+				//the older value was not written yet, only the newest one matters
+				Frame &frame = _lanes[LANE_BULK][it->second - _bulkHead];
+				_bytes -= frame.prefix.size() + frame.payload.size();
+				frame.prefix.swap(prefix);
+				frame.payload.swap(payload);
+				_bytes += frame.prefix.size() + frame.payload.size();
+				++_coalesced;
+				if(_bytes >= _high)
+					_full = true;
+				return;
+			}
+			_keyed[key] = _bulkHead + _lanes[LANE_BULK].size();
+		}
+		_keys.push_back(key);
+	}
+	_lanes[lane].push_back(Frame());
+	_lanes[lane].back().prefix.swap(prefix);
+	_lanes[lane].back().payload.swap(payload);
+	_bytes += _lanes[lane].back().prefix.size() + _lanes[lane].back().payload.size();
+	if(_bytes >= _high)
+		_full = true;
+	_ready.signal();
+}
+
+void SIOSendQueue::push(Lane lane, std::vector<std::string> &frames)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	for(std::size_t i = 0; i < frames.size(); ++i)
+	{
+		_lanes[lane].push_back(Frame());
+		_lanes[lane].back().payload.swap(frames[i]);
+		if(lane == LANE_BULK)
+			_keys.push_back(std::string());
+		_bytes += _lanes[lane].back().payload.size();
+	}
+	if(_bytes >= _high)
+		_full = true;
+	_ready.signal();
+}
+
+bool SIOSendQueue::pop(std::vector<Frame> &batch, std::size_t maxBytes)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	while(_lanes[LANE_CONTROL].empty() && _lanes[LANE_BULK].empty() && !_drained)
+	{
+		if(_closed)
+			return false;
+		_ready.wait(_mutex);
+	}
+
+	std::deque<Frame> &control = _lanes[LANE_CONTROL];
+	for(; !control.empty(); control.pop_front())
+	{
+		batch.push_back(Frame());
+		batch.back().prefix.swap(control.front().prefix);
+		batch.back().payload.swap(control.front().payload);
+		_bytes -= batch.back().prefix.size() + batch.back().payload.size();
+	}
+
+	std::deque<Frame> &bulk = _lanes[LANE_BULK];
+	std::size_t size = 0;
+	while(!bulk.empty())
+	{
+		std::size_t next = bulk.front().prefix.size() + bulk.front().payload.size();
+		if(size > 0 && size + next > maxBytes)
+			break;
+		batch.push_back(Frame());
+		batch.back().prefix.swap(bulk.front().prefix);
+		batch.back().payload.swap(bulk.front().payload);
+		bulk.pop_front();
+		if(!_keys.front().empty())
+			_keyed.erase(_keys.front());
+		_keys.pop_front();
+		++_bulkHead;
+		_bytes -= next;
+		size += next;
+	}
+
+	if(_full && _bytes <= _low)
+	{
+		_full = false;
+		_drained = true;
+	}
+	if(_bytes < _max)
+		_room.broadcast();
+	return true;
+}
+
+void SIOSendQueue::close()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_closed = true;
+	_ready.broadcast();
+	_room.broadcast();
+}
+
+std::size_t SIOSendQueue::clear()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	std::size_t dropped = _lanes[LANE_CONTROL].size() + _lanes[LANE_BULK].size();
+	_lanes[LANE_CONTROL].clear();
+	_lanes[LANE_BULK].clear();
+	_keys.clear();
+	_keyed.clear();
+	_bytes = 0;
+	if(_full)
+	{
+		//wake the writer so that the "drain" event is not held until the next frame
+		_full = false;
+		_drained = true;
+		_ready.signal();
+	}
+	_room.broadcast();
+	return dropped;
+}
+
+std::size_t SIOSendQueue::bytes()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _bytes;
+}
+
+std::size_t SIOSendQueue::frames()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _lanes[LANE_CONTROL].size() + _lanes[LANE_BULK].size();
+}
+
+void SIOSendQueue::setWatermarks(std::size_t high, std::size_t low)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_high = high;
+	_low = low < high ? low : high;
+}
+
+bool SIOSendQueue::aboveHigh()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _full;
+}
+
+bool SIOSendQueue::takeDrained()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	bool drained = _drained;
+	_drained = false;
+	return drained;
+}
+
+void SIOSendQueue::setMaxBytes(std::size_t max)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_max = max;
+}
+
+bool SIOSendQueue::waitForRoom(long timeout)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	Poco::Timestamp start;
+	while(_bytes >= _max)
+	{
+		long left = timeout - (long)(start.elapsed() / 1000);
+		if(_closed || left <= 0)
+			return false;
+		_room.tryWait(_mutex, left);
+	}
+	return true;
+}
+
+std::size_t SIOSendQueue::coalesced()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _coalesced;
+}
@@ -0,0 +1,169 @@
+#include "SIOTrace.h"
+
+#include <cstring>
+#include <ctime>
+
+#include "Poco/Timestamp.h"
+
+namespace
+{
+	static Poco::SingletonHolder<SIOTracer> sh;
+
+	//the flush thread wakes up this often
+	static const long FLUSH_INTERVAL = 50;
+
+	//the coarse clock reads the time of the last tick without asking the
+	//hardware, a few ns instead of a few tens for the precise one
+	Poco::UInt64 now()
+	{
+#ifdef CLOCK_REALTIME_COARSE
+		timespec ts;
+		clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+		return (Poco::UInt64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+		return Poco::Timestamp().epochMicroseconds();
+#endif
+	}
+}
+
+SIOTracer *SIOTracer::instance()
+{
+	return sh.get();
+}
+
+SIOTracer::SIOTracer() :
+	_slots(NULL),
+	_capacity(0),
+	_enqueue(0),
+	_dequeue(0),
+	_enabled(false),
+	_dropped(0),
+	_connections(0),
+	_file(NULL),
+	_stop(false),
+	_flushAdapter(*this, &SIOTracer::flushLoop)
+{
+}
+
+SIOTracer::~SIOTracer()
+{
+	stop();
+	delete[] _slots;
+}
+
+bool SIOTracer::start(const std::string &path, std::size_t capacity)
+{
+	if(_file)
+		return false;
+	_file = fopen(path.c_str(), "wb");
+	if(!_file)
+		return false;
+
+	if(!_slots)
+	{
+		_capacity = 1;
+		while(_capacity < capacity)
+			_capacity <<= 1;
+		//slot i is free for the producer that gets position i
+		_slots = new Slot[_capacity];
+		for(std::size_t i = 0; i < _capacity; ++i)
+			_slots[i].sequence.store(i);
+	}
+
+	SIOTraceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SIOTRACE", 8);
+	header.version = 2;
+	header.recordSize = sizeof(SIOTraceRecord);
+	fwrite(&header, sizeof(header), 1, _file);
+
+	_stop.reset();
+	_thread.start(_flushAdapter);
+	//publishes _slots and _capacity to the threads checking enabled()
+	_enabled.store(true, std::memory_order_release);
+	return true;
+}
+
+void SIOTracer::stop()
+{
+	if(!_file)
+		return;
+	_enabled.store(false, std::memory_order_release);
+	_stop.set();
+	_thread.join();
+	drain();
+	fclose(_file);
+	_file = NULL;
+}
+
+void SIOTracer::record(Poco::UInt32 connection, Direction direction, int flags,
+	const char *head, std::size_t headSize, const char *data, std::size_t size)
+{
+	if(!enabled())
+		return;
+
+	//bounded multi producer queue: claim a position, fill its slot, publish it
+	Poco::UInt64 pos = _enqueue.load(std::memory_order_relaxed);
+	Slot *slot;
+	for(;;)
+	{
+		slot = &_slots[pos & (_capacity - 1)];
+		Poco::UInt64 sequence = slot->sequence.load(std::memory_order_acquire);
+		Poco::Int64 diff = (Poco::Int64)(sequence - pos);
+		if(diff == 0)
+		{
+			if(_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if(diff < 0)
+		{
+			//a lap ahead of the flush thread
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+			pos = _enqueue.load(std::memory_order_relaxed);
+	}
+
+	SIOTraceRecord &r = slot->record;
+	r.timestamp = now();
+	r.connection = connection;
+	r.length = (Poco::UInt32)(headSize + size);
+	r.direction = (Poco::UInt8)direction;
+	r.flags = (Poco::UInt8)flags;
+	std::size_t kept = headSize < SIO_TRACE_PAYLOAD ? headSize : SIO_TRACE_PAYLOAD;
+	if(kept > 0)
+		memcpy(r.data, head, kept);
+	std::size_t rest = size < SIO_TRACE_PAYLOAD - kept ? size : SIO_TRACE_PAYLOAD - kept;
+	if(rest > 0)
+		memcpy(r.data + kept, data, rest);
+	r.size = (Poco::UInt16)(kept + rest);
+
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+std::size_t SIOTracer::drain()
+{
+	std::size_t count = 0;
+	for(;;)
+	{
+		Slot &slot = _slots[_dequeue & (_capacity - 1)];
+		if(slot.sequence.load(std::memory_order_acquire) != _dequeue + 1)
+			break;//empty, or the producer is still filling it
+		fwrite(&slot.record, sizeof(SIOTraceRecord), 1, _file);
+		//free for the producer one lap later
+		slot.sequence.store(_dequeue + _capacity, std::memory_order_release);
+		++_dequeue;
+		++count;
+	}
+	return count;
+}
+
+void SIOTracer::flushLoop()
+{
+	while(!_stop.tryWait(FLUSH_INTERVAL))
+	{
+		if(drain() > 0)
+			fflush(_file);
+	}
+}
@@ -0,0 +1,165 @@
+// connections_bench.cpp : received events decoded and dispatched per second
+// with the namespaces of one host spread over 1 to K connections, each fed by
+// a thread of its own as its receive thread would, without network
+//
+// usage: socketiopoco_connections_bench [max connections] [namespaces] [milliseconds]
+//
+// What SIOConfig::connections parallelizes is the receive side: every
+// connection decodes and dispatches its frames on its own thread. The sockets
+// come from SIOClientImpl::replay and the namespaces are assigned round robin,
+// so each step runs the library's receive path from frame to handler on k
+// threads at once. Events of a namespace must arrive on its own connection:
+// handlers count what reaches a client of another one as misrouted.
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Poco/Net/WebSocket.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include "Poco/URI.h"
+
+#include "SIOClient.h"
+#include "SIOClientImpl.h"
+#include "SIOClientRegistry.h"
+
+//the connection whose frames the calling thread feeds
+static thread_local SIOClientImpl *feeding = NULL;
+
+//handler of the namespaces of one connection
+class CountingTarget : public SIOEventTarget
+{
+public:
+	void onEvent(const void *pSender, Array::Ptr &args)
+	{
+		SIOClient *client = static_cast<SIOClient *>(const_cast<void *>(pSender));
+		if(client->getSocket() == feeding)
+			handled.add(1);
+		else
+			misrouted.add(1);
+	};
+
+	SIOCounter handled;
+	SIOCounter misrouted;
+};
+
+//the receive thread of one connection: its namespaces' frames, in turn
+class Feeder: public Poco::Runnable
+{
+public:
+	Feeder(SIOClientImpl *socket, volatile bool &stop) : _socket(socket), _stop(stop), frames(0) {};
+
+	void run()
+	{
+		feeding = _socket;
+		while(!_stop)
+		{
+			for(std::size_t i = 0; i < data.size(); ++i)
+				_socket->replayFrame(data[i].data(), data[i].size(), Poco::Net::WebSocket::FRAME_TEXT);
+			frames += data.size();
+		}
+	}
+
+	std::vector<std::string> data;
+
+private:
+	SIOClientImpl *_socket;
+	volatile bool &_stop;
+
+public:
+	Poco::UInt64 frames;
+};
+
+static double step(int connections, int namespaces, long ms, double base)
+{
+	SIOConfig config;
+	std::vector<Poco::AutoPtr<SIOClientImpl> > sockets;
+	std::vector<CountingTarget> targets(connections);
+	std::vector<Feeder *> feeders;
+	volatile bool stop = false;
+	for(int i = 0; i < connections; ++i)
+	{
+		//replay sockets all on the same host, registered like SIOClient::connect does
+		sockets.push_back(Poco::AutoPtr<SIOClientImpl>(SIOClientImpl::replay(Poco::URI("http://bench:80"), SocketIOPacket::V10x, config), true));
+		std::stringstream key;
+		key << "bench:80";
+		if(i > 0)
+			key << "#" << i;
+		SIOClientRegistry::instance()->addSocket(sockets[i], key.str());
+		feeders.push_back(new Feeder(sockets[i], stop));
+	}
+
+	//the default namespace is open on every connection but has its client
+	//on the first one only, the others must not hand it their events
+	std::vector<SIOClient *> clients;
+	for(int n = 0; n <= namespaces; ++n)
+	{
+		std::stringstream endpoint;
+		if(n > 0)
+			endpoint << "/ns" << n;
+		int i = n % connections;
+		SIOClient *client = new SIOClient("bench:80" + endpoint.str(), endpoint.str(), sockets[i]);
+		SIOClientRegistry::instance()->addClient(client);
+		client->on("tick", &targets[i], callback(&CountingTarget::onEvent));
+		clients.push_back(client);
+
+		std::string prefix = n > 0 ? "42" + endpoint.str() + "," : "42";
+		feeders[i]->data.push_back(prefix + "[\"tick\",{\"seq\":1,\"price\":101.25,\"size\":300,\"side\":\"buy\"}]");
+	}
+	for(int i = 1; i < connections; ++i)
+		feeders[i]->data.push_back("42[\"tick\",{\"seq\":1,\"price\":101.25,\"size\":300,\"side\":\"buy\"}]");
+
+	std::vector<Poco::Thread *> threads;
+	Poco::Timestamp start;
+	for(int i = 0; i < connections; ++i)
+	{
+		threads.push_back(new Poco::Thread());
+		threads[i]->start(*feeders[i]);
+	}
+	Poco::Thread::sleep(ms);
+	stop = true;
+	for(int i = 0; i < connections; ++i)
+		threads[i]->join();
+	double seconds = start.elapsed() / 1e6;
+
+	Poco::UInt64 frames = 0, handled = 0, misrouted = 0;
+	for(int i = 0; i < connections; ++i)
+	{
+		frames += feeders[i]->frames;
+		handled += targets[i].handled.get();
+		misrouted += targets[i].misrouted.get();
+		delete feeders[i];
+		delete threads[i];
+	}
+
+	double rate = handled / seconds;
+	printf("%11d %14.0f %12.0f %8.2fx %10llu\n", connections, frames / seconds, rate,
+		base > 0 ? rate / base : 1.0, (unsigned long long)misrouted);
+
+	//the sockets go with their last client and the reference held here
+	for(std::size_t i = 0; i < clients.size(); ++i)
+		clients[i]->disconnect();
+	return rate;
+}
+
+int main(int argc, char* argv[])
+{
+	int maxConnections = argc > 1 ? atoi(argv[1]) : 8;
+	int namespaces = argc > 2 ? atoi(argv[2]) : 32;
+	long ms = argc > 3 ? atol(argv[3]) : 2000;
+
+	printf("%d namespaces, %ld ms per step\n", namespaces, ms);
+	printf("%11s %14s %12s %9s %10s\n", "connections", "frames/s", "events/s", "speedup", "misrouted");
+	double base = 0;
+	for(int k = 1; k <= maxConnections; k *= 2)
+	{
+		double rate = step(k, namespaces, ms, base);
+		if(k == 1)
+			base = rate;
+	}
+	return 0;
+}
@@ -0,0 +1,168 @@
+// json_bench.cpp : compares the JSON backends over a corpus of socket.io frames
+//
+// usage: socketiopoco_json_bench [corpus file] [iterations]
+// the corpus is one raw text frame per line, as received from the server
+//
+// The scanner only skips the Poco::JSON DOM for string arguments, so both
+// backends also run on events that carry only strings and on events that
+// carry an object, the usual payload.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Poco/Timestamp.h"
+
+#include "SIOJSON.h"
+#include "SIOPacket.h"
+
+#ifndef SIO_BENCH_CORPUS
+#define SIO_BENCH_CORPUS "corpus"
+#endif
+
+struct Frame
+{
+	bool handshake;
+	SocketIOPacket::SocketIOVersion version;
+	std::string json;
+};
+
+//strip the socket.io header the same way SIOClientImpl::receive does
+static bool loadFrame(const std::string &line, Frame &f)
+{
+	f.handshake = false;
+	if(line.size() < 2)
+		return false;
+
+	if(line[0] == '0' && line[1] == '{')
+	{
+		f.handshake = true;
+		f.version = SocketIOPacket::V10x;
+		f.json = line.substr(1);
+		return true;
+	}
+	if(line[1] == ':')
+	{
+		std::size_t pos = 0;
+		for(int i = 0; i < 3 && pos != std::string::npos; ++i)
+			pos = line.find(':', pos + 1);
+		if(pos == std::string::npos)
+			return false;
+		f.version = SocketIOPacket::V09x;
+		f.json = line.substr(pos + 1);
+		return true;
+	}
+	if(line[0] == '4' && line[1] == '2')
+	{
+		std::size_t pos = line.find('[');
+		if(pos == std::string::npos)
+			return false;
+		f.version = SocketIOPacket::V10x;
+		f.json = line.substr(pos);
+		return true;
+	}
+	return false;
+}
+
+template <class Backend>
+static bool parseFrame(const Frame &f, std::size_t &args)
+{
+	if(f.handshake)
+	{
+		SIOHandshake hs;
+		return Backend::parseHandshake(f.json, hs);
+	}
+	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("event", f.version);
+	bool ok = Backend::parseEvent(f.json, f.version, packet);
+	args += packet->getDatas().size();
+	delete packet;
+	return ok;
+}
+
+//V10x events all carrying the same argument
+static std::vector<Frame> events(const std::string &arg, std::size_t &bytes)
+{
+	std::vector<Frame> frames;
+	bytes = 0;
+	for(int i = 0; i < 64; ++i)
+	{
+		Frame f;
+		f.handshake = false;
+		f.version = SocketIOPacket::V10x;
+		f.json = "[\"tick\"," + arg + "]";
+		bytes += f.json.size();
+		frames.push_back(f);
+	}
+	return frames;
+}
+
+template <class Backend>
+static void run(const std::vector<Frame> &frames, std::size_t bytes, int iterations)
+{
+	std::size_t args = 0;
+	int failures = 0;
+
+	//warm up
+	for(std::size_t i = 0; i < frames.size(); ++i)
+		parseFrame<Backend>(frames[i], args);
+
+	args = 0;
+	Poco::Timestamp start;
+	for(int it = 0; it < iterations; ++it)
+		for(std::size_t i = 0; i < frames.size(); ++i)
+			if(!parseFrame<Backend>(frames[i], args))
+				++failures;
+	Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+
+	double total = (double)frames.size() * iterations;
+	std::cout << Backend::name() << ":\t"
+		<< (elapsed * 1000.0 / total) << " ns/frame\t"
+		<< ((double)bytes * iterations / elapsed) << " MB/s\t"
+		<< "args: " << args << "\tfailures: " << failures << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = argc > 1 ? argv[1] : SIO_BENCH_CORPUS "/frames.txt";
+	int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+
+	std::ifstream in(path.c_str());
+	if(!in)
+	{
+		std::cerr << "Cannot open corpus " << path << std::endl;
+		return 1;
+	}
+
+	std::vector<Frame> frames;
+	std::size_t bytes = 0;
+	std::string line;
+	while(std::getline(in, line))
+	{
+		Frame f;
+		if(loadFrame(line, f))
+		{
+			frames.push_back(f);
+			bytes += f.json.size();
+		}
+	}
+
+	std::cout << frames.size() << " frames, " << bytes << " bytes of JSON, "
+		<< iterations << " iterations (default backend: " << SIOJSON::name() << ")" << std::endl;
+
+	run<SIOJSONPoco>(frames, bytes, iterations);
+	run<SIOJSONScanner>(frames, bytes, iterations);
+
+	std::cout << "string arguments:" << std::endl;
+	frames = events("\"AAPL\",\"buy\",\"101.25\",\"300\"", bytes);
+	run<SIOJSONPoco>(frames, bytes, iterations);
+	run<SIOJSONScanner>(frames, bytes, iterations);
+
+	std::cout << "object argument:" << std::endl;
+	frames = events("{\"symbol\":\"AAPL\",\"side\":\"buy\",\"price\":101.25,\"size\":300,\"tags\":[\"a\",\"b\"]}", bytes);
+	run<SIOJSONPoco>(frames, bytes, iterations);
+	run<SIOJSONScanner>(frames, bytes, iterations);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+// mask_bench.cpp : websocket payload masking, byte loop against SIOFrameWriter::mask
+//
+// usage: socketiopoco_mask_bench [iterations]
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Poco/Timestamp.h"
+
+#include "SIOFrameWriter.h"
+
+//what WebSocket::sendFrame does
+static void maskBytes(char *data, std::size_t size, const unsigned char key[4])
+{
+	for(std::size_t i = 0; i < size; ++i)
+		data[i] ^= key[i & 3];
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 200;
+	const unsigned char key[4] = {0x37, 0xfa, 0x21, 0x3d};
+	const std::size_t sizes[] = {1024, 64 * 1024, 1024 * 1024};
+
+	for(int s = 0; s < 3; ++s)
+	{
+		std::string a(sizes[s], 'x');
+		for(std::size_t i = 0; i < a.size(); ++i)
+			a[i] = (char)(i * 31);
+		std::string b = a;
+
+		//scale the iterations so every size masks the same amount of data
+		int n = (int)(iterations * (1024 * 1024 / sizes[s]));
+
+		Poco::Timestamp start;
+		for(int i = 0; i < n; ++i)
+			maskBytes(&a[0], a.size(), key);
+		Poco::Timestamp::TimeDiff bytewise = start.elapsed();
+
+		start.update();
+		for(int i = 0; i < n; ++i)
+			SIOFrameWriter::mask(&b[0], b.size(), key, 0);
+		Poco::Timestamp::TimeDiff simd = start.elapsed();
+
+		double mb = (double)sizes[s] * n / (1024 * 1024);
+		std::cout << sizes[s] << " bytes:\tbyte loop " << (mb / bytewise * 1e6) << " MB/s\t"
+			<< "SIOFrameWriter::mask " << (mb / simd * 1e6) << " MB/s\t"
+			<< (a == b ? "match" : "MISMATCH") << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,165 @@
+// registry_bench.cpp : concurrent SIOClientRegistry lookups while other threads
+// add and remove entries, against a std::map behind one mutex
+//
+// usage: socketiopoco_registry_bench [threads] [writers] [milliseconds]
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Poco/Mutex.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+
+#include "SIOClientImpl.h"
+#include "SIOClientRegistry.h"
+
+static const int URIS = 256;
+//lookups take a reference, the uris map to real sockets: replay ones, without network
+static const int SOCKETS = 8;
+
+//the registry before it was made concurrent, with the lock it was missing
+class LockedRegistry
+{
+public:
+	Poco::AutoPtr<SIOClientImpl> getSocket(const std::string &uri)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		std::map<std::string, SIOClientImpl *>::iterator it = _map.find(uri);
+		return Poco::AutoPtr<SIOClientImpl>(it != _map.end() ? it->second : NULL, true);
+	}
+	void addSocket(SIOClientImpl *socket, const std::string &uri)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_map[uri] = socket;
+	}
+	void removeSocket(const std::string &uri)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_map.erase(uri);
+	}
+
+private:
+	std::map<std::string, SIOClientImpl *> _map;
+	Poco::FastMutex _mutex;
+};
+
+template <class Registry>
+class Worker: public Poco::Runnable
+{
+public:
+	Worker(Registry &registry, const std::vector<std::string> &uris, const std::vector<SIOClientImpl *> &sockets, bool writer, volatile bool &stop) :
+		_registry(registry), _uris(uris), _sockets(sockets), _writer(writer), _stop(stop), ops(0), hits(0)
+	{
+	}
+
+	void run()
+	{
+		unsigned int seed = (unsigned int)(std::size_t)this;
+		while(!_stop)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const std::string &uri = _uris[(seed >> 8) % _uris.size()];
+			if(_writer)
+			{
+				if(seed & 0x10000)
+					_registry.addSocket(_sockets[(seed >> 20) % _sockets.size()], uri);
+				else
+					_registry.removeSocket(uri);
+			}
+			else if(_registry.getSocket(uri))
+				++hits;
+			++ops;
+		}
+	}
+
+private:
+	Registry &_registry;
+	const std::vector<std::string> &_uris;
+	const std::vector<SIOClientImpl *> &_sockets;
+	bool _writer;
+	volatile bool &_stop;
+
+public:
+	long long ops;
+	long long hits;
+};
+
+template <class Registry>
+static void bench(const char *name, Registry &registry, const std::vector<std::string> &uris, const std::vector<SIOClientImpl *> &sockets, int threads, int writers, long ms)
+{
+	for(std::size_t i = 0; i < uris.size(); i += 2)
+		registry.addSocket(sockets[i % sockets.size()], uris[i]);
+
+	volatile bool stop = false;
+	std::vector<Worker<Registry> *> workers;
+	std::vector<Poco::Thread *> pool;
+	for(int i = 0; i < threads; ++i)
+	{
+		workers.push_back(new Worker<Registry>(registry, uris, sockets, i < writers, stop));
+		pool.push_back(new Poco::Thread());
+	}
+
+	Poco::Timestamp start;
+	for(int i = 0; i < threads; ++i)
+		pool[i]->start(*workers[i]);
+	Poco::Thread::sleep(ms);
+	stop = true;
+	for(int i = 0; i < threads; ++i)
+		pool[i]->join();
+	Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+
+	long long reads = 0, writes = 0;
+	for(int i = 0; i < threads; ++i)
+	{
+		if(i < writers)
+			writes += workers[i]->ops;
+		else
+			reads += workers[i]->ops;
+		delete workers[i];
+		delete pool[i];
+	}
+
+	std::cout << name << ":\t" << (reads / (elapsed / 1e6) / 1e6) << " M lookups/s\t"
+		<< (writes / (elapsed / 1e6) / 1e3) << " K updates/s" << std::endl;
+
+	for(std::size_t i = 0; i < uris.size(); ++i)
+		registry.removeSocket(uris[i]);
+}
+
+int main(int argc, char* argv[])
+{
+	int threads = argc > 1 ? atoi(argv[1]) : 32;
+	int writers = argc > 2 ? atoi(argv[2]) : 2;
+	long ms = argc > 3 ? atol(argv[3]) : 2000;
+
+	std::vector<std::string> uris;
+	for(int i = 0; i < URIS; ++i)
+	{
+		std::stringstream ss;
+		ss << "host" << (i % 8) << ":3000/namespace" << i;
+		uris.push_back(ss.str());
+	}
+
+	//held by the benchmark for its whole run
+	std::vector<Poco::AutoPtr<SIOClientImpl> > held;
+	std::vector<SIOClientImpl *> sockets;
+	for(int i = 0; i < SOCKETS; ++i)
+	{
+		std::stringstream ss;
+		ss << "http://bench-" << i << ":80";
+		held.push_back(Poco::AutoPtr<SIOClientImpl>(SIOClientImpl::replay(Poco::URI(ss.str()), SocketIOPacket::V10x, SIOConfig()), true));
+		sockets.push_back(held.back());
+	}
+
+	std::cout << threads << " threads, " << writers << " writing" << std::endl;
+
+	LockedRegistry locked;
+	bench("std::map + mutex", locked, uris, sockets, threads, writers, ms);
+	bench("SIOClientRegistry", *SIOClientRegistry::instance(), uris, sockets, threads, writers, ms);
+	return 0;
+}
@@ -0,0 +1,113 @@
+// scan_bench.cpp : frame header scanning, the previous tokenizer based decoding
+// against SIOFrameScanner, on 1 KB, 64 KB and 1 MB frames
+//
+// usage: socketiopoco_scan_bench [iterations]
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Poco/StringTokenizer.h"
+#include "Poco/Timestamp.h"
+
+#include "SIOFrameScanner.h"
+
+using Poco::StringTokenizer;
+
+//build a frame of about size bytes: header then an event whose JSON has plenty of ':'
+static std::string makeFrame(const std::string &header, bool v09x, std::size_t size)
+{
+	std::string body;
+	while(body.size() < size)
+		body += "{\"id\":42,\"pos\":{\"x\":1.5,\"y\":-3.25},\"name\":\"caf\xc3\xa9 \xe2\x98\x83\"},";
+	body.erase(body.size() - 1);
+	if(v09x)
+		return header + "{\"name\":\"state\",\"args\":[" + body + "]}";
+	return header + "[\"state\"," + body + "]";
+}
+
+//V09x decoding as SIOClientImpl::receive did it: split everything, glue the payload back
+static std::size_t tokenizerV09x(const std::string &frame)
+{
+	StringTokenizer st(frame, ":");
+	std::string endpoint = st[2];
+	std::string payload = "";
+	for(std::size_t i = 3; i < st.count(); i++)
+	{
+		if(i != 3) payload += ":";
+		payload += st[i];
+	}
+	return endpoint.size() + payload.size();
+}
+
+//V10x decoding as SIOClientImpl::receive did it
+static std::size_t substrV10x(const std::string &frame)
+{
+	std::string data = frame.substr(1);
+	data = data.substr(1);
+	std::string endpoint = "";
+	std::size_t nendpoint = data.find("[");
+	if(nendpoint != std::string::npos)
+	{
+		endpoint += data.substr(0,nendpoint);
+		data = data.substr(nendpoint);
+	}
+	return endpoint.size() + data.size();
+}
+
+static std::size_t scannerV09x(const std::string &frame)
+{
+	SIOFrameHeader h;
+	SIOFrameScanner::parseV09x(frame.data(), frame.size(), h);
+	return h.endpointSize + h.payloadSize;
+}
+
+static std::size_t scannerV10x(const std::string &frame)
+{
+	SIOFrameHeader h;
+	SIOFrameScanner::parseV10x(frame.data(), frame.size(), h);
+	return h.endpointSize + h.payloadSize;
+}
+
+static std::size_t scannerV10xUTF8(const std::string &frame)
+{
+	if(!SIOFrameScanner::validUTF8(frame.data(), frame.size()))
+		return 0;
+	return scannerV10x(frame);
+}
+
+static void run(const char *name, std::size_t (*decode)(const std::string &), const std::string &frame, int n)
+{
+	std::size_t check = 0;
+	Poco::Timestamp start;
+	for(int i = 0; i < n; ++i)
+		check += decode(frame);
+	Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+	std::cout << "  " << name << ":\t" << ((double)elapsed * 1000.0 / n) << " ns/frame\t"
+		<< ((double)frame.size() * n / elapsed) << " MB/s\t(" << check / n << " bytes)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 100;
+	const std::size_t sizes[] = {1024, 64 * 1024, 1024 * 1024};
+
+	for(int s = 0; s < 3; ++s)
+	{
+		//same amount of data for every size
+		int n = (int)(iterations * (1024 * 1024 / sizes[s]));
+		if(n < 1)
+			n = 1;
+
+		std::string v09x = makeFrame("5::/feed:", true, sizes[s]);
+		std::string v10x = makeFrame("42/feed,", false, sizes[s]);
+
+		std::cout << sizes[s] << " bytes, " << n << " frames" << std::endl;
+		run("V09x StringTokenizer", tokenizerV09x, v09x, n);
+		run("V09x SIOFrameScanner", scannerV09x, v09x, n);
+		run("V10x find/substr    ", substrV10x, v10x, n);
+		run("V10x SIOFrameScanner", scannerV10x, v10x, n);
+		run("V10x scanner + UTF-8", scannerV10xUTF8, v10x, n);
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+// trace_bench.cpp : what SIOTracer costs a receive or writer thread per frame,
+// tracing off and on, from 1 to N threads recording at once
+//
+// usage: socketiopoco_trace_bench [trace file] [threads] [frames per thread]
+//
+// Each thread records the same 1 KB frame in a loop, the way SIOClientImpl
+// calls the tracer on every frame it reads or writes. A full ring drops frames
+// instead of waiting for the file, which is much cheaper than recording them:
+// the ring is sized for every frame of the largest step so that the cost is
+// the one of frames actually traced, and the drop count shows it stayed so.
+// Costs are wall time per frame of each thread: with more threads than cores
+// they include the time the thread was not scheduled.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+
+#include "SIOTrace.h"
+
+class Recorder: public Poco::Runnable
+{
+public:
+	Recorder(Poco::UInt32 connection, long frames) : _connection(connection), _frames(frames), micros(0) {};
+
+	void run()
+	{
+		std::string head("42/chat,");
+		std::string data(1024 - head.size(), 'x');
+		SIOTracer *tracer = SIOTracer::instance();
+		Poco::Timestamp start;
+		for(long i = 0; i < _frames; ++i)
+		{
+			//as the I/O threads do: the check inline, the copy only when on
+			if(tracer->enabled())
+				tracer->record(_connection, (i & 1) ? SIOTracer::IN : SIOTracer::OUT, 0x81,
+					head.data(), head.size(), data.data(), data.size());
+		}
+		micros = start.elapsed();
+	}
+
+private:
+	Poco::UInt32 _connection;
+	long _frames;
+
+public:
+	Poco::Timestamp::TimeDiff micros;
+};
+
+//nanoseconds per frame, averaged over the threads
+static double run(int threads, long frames)
+{
+	std::vector<Recorder *> recorders;
+	std::vector<Poco::Thread *> pool;
+	for(int i = 0; i < threads; ++i)
+	{
+		recorders.push_back(new Recorder(SIOTracer::instance()->nextConnection(), frames));
+		pool.push_back(new Poco::Thread());
+	}
+	for(int i = 0; i < threads; ++i)
+		pool[i]->start(*recorders[i]);
+	double ns = 0;
+	for(int i = 0; i < threads; ++i)
+	{
+		pool[i]->join();
+		ns += recorders[i]->micros * 1000.0 / frames;
+		delete recorders[i];
+		delete pool[i];
+	}
+	return ns / threads;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = argc > 1 ? argv[1] : "/tmp/socketiopoco_trace_bench.trace";
+	int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+	long frames = argc > 3 ? atol(argv[3]) : 50000;
+
+	printf("%ld frames of 1 KB per thread, tracing into %s\n", frames, path.c_str());
+	printf("%8s %14s %14s %12s\n", "threads", "off (ns/frame)", "on (ns/frame)", "dropped");
+	for(int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		double off = run(threads, frames);
+
+		//the ring is allocated by the first start and kept
+		if(!SIOTracer::instance()->start(path, (std::size_t)maxThreads * frames))
+		{
+			fprintf(stderr, "cannot write %s\n", path.c_str());
+			return 1;
+		}
+		Poco::UInt64 dropped = SIOTracer::instance()->dropped();
+		double on = run(threads, frames);
+		dropped = SIOTracer::instance()->dropped() - dropped;
+		SIOTracer::instance()->stop();
+
+		printf("%8d %14.1f %14.1f %12llu\n", threads, off, on, (unsigned long long)dropped);
+	}
+	remove(path.c_str());
+	return 0;
+}
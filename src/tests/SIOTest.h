@@ -0,0 +1,35 @@
+#ifndef SIO_Test_INCLUDED
+#define SIO_Test_INCLUDED
+
+#include <iostream>
+
+//Checks for the unit tests. Unlike assert they stay on in release builds and
+//a failure does not stop the test, every failed check is printed; main
+//returns SIO_TEST_RESULT() so that ctest sees the outcome.
+
+static int sioTestFailures = 0;
+
+#define SIO_CHECK(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+		{ \
+			++sioTestFailures; \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+		} \
+	} while(0)
+
+#define SIO_CHECK_EQUAL(expected, actual) \
+	do \
+	{ \
+		if(!((expected) == (actual))) \
+		{ \
+			++sioTestFailures; \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": expected " #actual " to be [" << (expected) \
+				<< "], got [" << (actual) << "]" << std::endl; \
+		} \
+	} while(0)
+
+#define SIO_TEST_RESULT() (sioTestFailures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,117 @@
+// deflate_test.cpp : permessage-deflate offer and negotiation, and messages
+// making the round trip through the deflater and the inflater
+
+#include <string>
+
+#include "SIOConfig.h"
+#include "SIODeflate.h"
+#include "SIOTest.h"
+
+static void testOffer()
+{
+	SIOConfig config;
+	SIO_CHECK_EQUAL(std::string("permessage-deflate; client_max_window_bits"), SIODeflate(config).offer());
+
+	config.deflateWindowBits = 10;
+	config.deflateNoContextTakeover = true;
+	SIO_CHECK_EQUAL(std::string("permessage-deflate; client_max_window_bits=10; client_no_context_takeover; server_no_context_takeover"),
+		SIODeflate(config).offer());
+
+	//zlib has no 256 bytes window
+	config.deflateWindowBits = 8;
+	config.deflateNoContextTakeover = false;
+	SIO_CHECK_EQUAL(std::string("permessage-deflate; client_max_window_bits=9"), SIODeflate(config).offer());
+}
+
+static bool accepts(const std::string &response)
+{
+	SIOConfig config;
+	SIODeflate deflate(config);
+	return deflate.accept(response);
+}
+
+static void testAccept()
+{
+	SIO_CHECK(accepts("permessage-deflate"));
+	SIO_CHECK(accepts("permessage-deflate; client_max_window_bits=10"));
+	SIO_CHECK(accepts("permessage-deflate; server_max_window_bits=10; server_no_context_takeover"));
+	SIO_CHECK(accepts("foo, permessage-deflate; client_max_window_bits=\"12\""));
+
+	SIO_CHECK(!accepts(""));
+	SIO_CHECK(!accepts("x-webkit-deflate-frame"));
+	SIO_CHECK(!accepts("permessage-deflate; client_max_window_bits=8"));
+	SIO_CHECK(!accepts("permessage-deflate; client_max_window_bits=16"));
+	SIO_CHECK(!accepts("permessage-deflate; mystery_param"));
+
+	//the server may only lower the window we offered
+	SIOConfig config;
+	config.deflateWindowBits = 12;
+	SIODeflate deflate(config);
+	SIO_CHECK(deflate.accept("permessage-deflate; client_max_window_bits=10"));
+	SIO_CHECK_EQUAL(std::string("permessage-deflate; client_max_window_bits=10"), deflate.offer());
+	SIODeflate larger(config);
+	SIO_CHECK(larger.accept("permessage-deflate; client_max_window_bits=14"));
+	SIO_CHECK_EQUAL(std::string("permessage-deflate; client_max_window_bits=12"), larger.offer());
+}
+
+//sender and receiver of the same negotiation, each message inflated in order
+static void testRoundTrip(bool noContextTakeover)
+{
+	SIOConfig config;
+	config.deflateNoContextTakeover = noContextTakeover;
+	SIODeflate sender(config);
+	SIODeflate receiver(config);
+
+	std::string message = "42[\"tick\",{\"seq\":1,\"price\":101.25,\"size\":300,\"side\":\"buy\"}]";
+	std::string empty;
+	std::string large(100000, 'x');
+	for(std::size_t i = 0; i < large.size(); i += 7)
+		large[i] = (char)('a' + i % 26);
+	const std::string *messages[] = {&message, &message, &empty, &large, &message};
+
+	std::size_t first = 0;
+	for(int i = 0; i < 5; ++i)
+	{
+		std::string compressed, inflated;
+		SIO_CHECK(sender.compress(messages[i]->data(), messages[i]->size(), compressed));
+		SIO_CHECK(receiver.decompress(compressed.data(), compressed.size(), inflated));
+		SIO_CHECK_EQUAL(*messages[i], inflated);
+		if(i == 0)
+			first = compressed.size();
+		//with the context kept the repeated message refers to the first one
+		else if(i == 1 && !noContextTakeover)
+			SIO_CHECK(compressed.size() < first);
+		else if(i == 1)
+			SIO_CHECK_EQUAL(first, compressed.size());
+	}
+}
+
+//we asked for server_no_context_takeover but the server did not agree: its
+//messages refer to the previous ones and the inflater must keep them
+static void testServerKeepsContext()
+{
+	SIOConfig config;
+	SIODeflate server(config);
+	config.deflateNoContextTakeover = true;
+	SIODeflate client(config);
+	SIO_CHECK(client.accept("permessage-deflate"));
+
+	std::string message = "42[\"tick\",{\"seq\":1,\"price\":101.25,\"size\":300,\"side\":\"buy\"}]";
+	for(int i = 0; i < 3; ++i)
+	{
+		std::string compressed, inflated;
+		SIO_CHECK(server.compress(message.data(), message.size(), compressed));
+		SIO_CHECK(client.decompress(compressed.data(), compressed.size(), inflated));
+		SIO_CHECK_EQUAL(message, inflated);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	testOffer();
+	testAccept();
+	testRoundTrip(false);
+	testRoundTrip(true);
+	testServerKeepsContext();
+	return SIO_TEST_RESULT();
+}
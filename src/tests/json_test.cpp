@@ -0,0 +1,133 @@
+// json_test.cpp : the scanner backend gives the same results as the Poco one,
+// and both the expected ones, for every kind of payload the client parses
+
+#include <sstream>
+#include <string>
+
+#include "SIOJSON.h"
+#include "SIOPacket.h"
+#include "SIOTest.h"
+
+struct Event
+{
+	bool ok;
+	std::string name;
+	std::string args;//the arguments as handlers get them, stringified
+};
+
+template <class Backend>
+static Event parseEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version)
+{
+	Event event;
+	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("event", version);
+	event.ok = Backend::parseEvent(payload, version, packet);
+	event.name = packet->getEvent();
+	std::stringstream ss;
+	packet->getDatas().stringify(ss);
+	event.args = ss.str();
+	delete packet;
+	return event;
+}
+
+static void checkEvent(const std::string &payload, SocketIOPacket::SocketIOVersion version,
+	bool ok, const std::string &name = "", const std::string &args = "")
+{
+	Event poco = parseEvent<SIOJSONPoco>(payload, version);
+	Event scanner = parseEvent<SIOJSONScanner>(payload, version);
+	SIO_CHECK_EQUAL(ok, poco.ok);
+	SIO_CHECK_EQUAL(ok, scanner.ok);
+	if(!ok)
+		return;
+	SIO_CHECK_EQUAL(name, poco.name);
+	SIO_CHECK_EQUAL(name, scanner.name);
+	SIO_CHECK_EQUAL(poco.args, scanner.args);
+	if(!args.empty())
+		SIO_CHECK_EQUAL(args, scanner.args);
+}
+
+static void testEventV10x()
+{
+	SocketIOPacket::SocketIOVersion v = SocketIOPacket::V10x;
+	checkEvent("[\"chat\",\"hello\"]", v, true, "chat", "[\"hello\"]");
+	checkEvent(" [ \"chat\" , \"a\" ,\"b\" ] ", v, true, "chat", "[\"a\",\"b\"]");
+	checkEvent("[\"ping\"]", v, true, "ping", "[]");
+	checkEvent("[\"esc\",\"q\\\"b\\\\s\\/n\\n\"]", v, true, "esc");
+	//arguments that are not strings reach handlers as their JSON text
+	checkEvent("[\"tick\",{\"seq\":1,\"side\":\"buy\"},[1,2],true,null,42,101.25]", v, true, "tick");
+	checkEvent("[\"nested\",{\"a\":{\"b\":[\"]\",\"}\"]}},\"after\"]", v, true, "nested");
+
+	checkEvent("[]", v, false);
+	checkEvent("not json", v, false);
+	checkEvent("[\"chat\",\"hello\"", v, false);
+	checkEvent("{\"name\":\"chat\"}", v, false);
+}
+
+static void testEventV09x()
+{
+	SocketIOPacket::SocketIOVersion v = SocketIOPacket::V09x;
+	checkEvent("{\"name\":\"chat\",\"args\":[\"hello\"]}", v, true, "chat", "[\"hello\"]");
+	checkEvent("{\"args\":[\"a\",{\"k\":[1,2]},3],\"name\":\"order\"}", v, true, "order");
+	checkEvent("{\"name\":\"ping\"}", v, true, "ping", "[]");
+	checkEvent("{ \"name\" : \"spaced\" , \"args\" : [ \"x\" , 1 ] }", v, true, "spaced");
+
+	checkEvent("not json", v, false);
+	checkEvent("[\"chat\",\"hello\"]", v, false);
+	checkEvent("{\"name\":\"chat\",\"args\":[\"hello\"", v, false);
+}
+
+template <class Backend>
+static void checkHandshake()
+{
+	SIOHandshake hs;
+	SIO_CHECK(Backend::parseHandshake("{\"sid\":\"lv_VI97HAXpY6yYWAAAC\",\"upgrades\":[\"websocket\"],"
+		"\"pingInterval\":25000,\"pingTimeout\":20000,\"maxPayload\":1000000}", hs));
+	SIO_CHECK_EQUAL(std::string("lv_VI97HAXpY6yYWAAAC"), hs.sid);
+	SIO_CHECK_EQUAL(25000, hs.pingInterval);
+	SIO_CHECK_EQUAL(20000, hs.pingTimeout);
+
+	SIO_CHECK(!Backend::parseHandshake("{\"pingInterval\":25000}", hs));
+	SIO_CHECK(!Backend::parseHandshake("garbage", hs));
+}
+
+template <class Backend>
+static void checkConnect()
+{
+	std::string sid, pid = "stale";
+	SIO_CHECK(Backend::parseConnect("{\"sid\":\"abc\"}", sid, pid));
+	SIO_CHECK_EQUAL(std::string("abc"), sid);
+	SIO_CHECK_EQUAL(std::string(""), pid);
+	SIO_CHECK(Backend::parseConnect("{\"sid\":\"def\",\"pid\":\"p-1\"}", sid, pid));
+	SIO_CHECK_EQUAL(std::string("def"), sid);
+	SIO_CHECK_EQUAL(std::string("p-1"), pid);
+
+	SIO_CHECK(!Backend::parseConnect("{\"pid\":\"p-1\"}", sid, pid));
+	SIO_CHECK(!Backend::parseConnect("[\"abc\"]", sid, pid));
+}
+
+template <class Backend>
+static void checkOffset()
+{
+	std::string offset;
+	SIO_CHECK(Backend::parseOffset("[\"chat\",\"hello\",\"off-42\"]", offset));
+	SIO_CHECK_EQUAL(std::string("off-42"), offset);
+	SIO_CHECK(Backend::parseOffset("[\"chat\",\"off-43\"]", offset));
+	SIO_CHECK_EQUAL(std::string("off-43"), offset);
+
+	SIO_CHECK(!Backend::parseOffset("[\"chat\"]", offset));
+	SIO_CHECK(!Backend::parseOffset("[\"chat\",1]", offset));
+	SIO_CHECK(!Backend::parseOffset("[\"chat\",{\"a\":\"b\"}]", offset));
+	SIO_CHECK(!Backend::parseOffset("{\"a\":\"b\"}", offset));
+}
+
+int main(int argc, char* argv[])
+{
+	testEventV10x();
+	testEventV09x();
+	checkHandshake<SIOJSONPoco>();
+	checkHandshake<SIOJSONScanner>();
+	checkConnect<SIOJSONPoco>();
+	checkConnect<SIOJSONScanner>();
+	checkOffset<SIOJSONPoco>();
+	checkOffset<SIOJSONScanner>();
+	return SIO_TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+// sendqueue_test.cpp : SIOSendQueue lanes, batching, watermarks, the hard cap
+// emit waits on, and clear() counting as a drain
+
+#include <string>
+#include <vector>
+
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+
+#include "SIOSendQueue.h"
+#include "SIOTest.h"
+
+static void pushBulk(SIOSendQueue &queue, std::size_t size, char c)
+{
+	std::vector<std::string> frames;
+	frames.push_back(std::string(size, c));
+	queue.push(SIOSendQueue::LANE_BULK, frames);
+}
+
+//control frames jump the bulk ones, bulk batches end at a frame boundary
+static void testLanes()
+{
+	SIOSendQueue queue;
+	pushBulk(queue, 50000, 'a');
+	pushBulk(queue, 50000, 'b');
+	pushBulk(queue, 1, 'c');
+	std::string prefix = "2", payload;
+	queue.push(SIOSendQueue::LANE_CONTROL, prefix, payload);
+	SIO_CHECK_EQUAL(4u, queue.frames());
+	SIO_CHECK_EQUAL(100002u, queue.bytes());
+
+	std::vector<SIOSendQueue::Frame> batch;
+	SIO_CHECK(queue.pop(batch, 65536));
+	SIO_CHECK_EQUAL(2u, batch.size());
+	SIO_CHECK_EQUAL(std::string("2"), batch[0].prefix);
+	SIO_CHECK_EQUAL('a', batch[1].payload[0]);
+
+	batch.clear();
+	SIO_CHECK(queue.pop(batch, 65536));
+	SIO_CHECK_EQUAL(2u, batch.size());
+	SIO_CHECK_EQUAL(std::string("c"), batch[1].payload);
+	SIO_CHECK_EQUAL(0u, queue.bytes());
+
+	queue.close();
+	batch.clear();
+	SIO_CHECK(!queue.pop(batch, 65536));
+}
+
+//a keyed bulk frame replaces the unsent one with the same key, in its place
+static void testCoalescing()
+{
+	SIOSendQueue queue;
+	std::string prefix = "42", first = "[\"price\",1]", other = "[\"chat\",\"hi\"]", second = "[\"price\",2]";
+	queue.push(SIOSendQueue::LANE_BULK, prefix, first, "price");
+	prefix = "42";
+	queue.push(SIOSendQueue::LANE_BULK, prefix, other);
+	prefix = "42";
+	queue.push(SIOSendQueue::LANE_BULK, prefix, second, "price");
+	SIO_CHECK_EQUAL(2u, queue.frames());
+	SIO_CHECK_EQUAL(1u, queue.coalesced());
+
+	std::vector<SIOSendQueue::Frame> batch;
+	SIO_CHECK(queue.pop(batch, 65536));
+	SIO_CHECK_EQUAL(2u, batch.size());
+	SIO_CHECK_EQUAL(std::string("[\"price\",2]"), batch[0].payload);
+	SIO_CHECK_EQUAL(std::string("[\"chat\",\"hi\"]"), batch[1].payload);
+}
+
+//above high until the writer brings it down to low, drained reported once
+static void testWatermarks()
+{
+	SIOSendQueue queue;
+	queue.setWatermarks(100, 10);
+	pushBulk(queue, 60, 'a');
+	SIO_CHECK(!queue.aboveHigh());
+	pushBulk(queue, 60, 'b');
+	SIO_CHECK(queue.aboveHigh());
+
+	std::vector<SIOSendQueue::Frame> batch;
+	SIO_CHECK(queue.pop(batch, 60));
+	SIO_CHECK_EQUAL(1u, batch.size());
+	//60 bytes left, below high but not yet drained to low
+	SIO_CHECK(!queue.takeDrained());
+
+	batch.clear();
+	SIO_CHECK(queue.pop(batch, 60));
+	SIO_CHECK(!queue.aboveHigh());
+	SIO_CHECK(queue.takeDrained());
+	SIO_CHECK(!queue.takeDrained());
+}
+
+class Writer: public Poco::Runnable
+{
+public:
+	Writer(SIOSendQueue &queue) : _queue(queue) {};
+
+	void run()
+	{
+		Poco::Thread::sleep(30);
+		std::vector<SIOSendQueue::Frame> batch;
+		_queue.pop(batch, 1000);
+	}
+
+private:
+	SIOSendQueue &_queue;
+};
+
+//past the hard cap waitForRoom times out, until the writer makes room
+static void testHardCap()
+{
+	SIOSendQueue queue;
+	queue.setWatermarks(100, 10);
+	queue.setMaxBytes(200);
+	SIO_CHECK(queue.waitForRoom(0));
+	pushBulk(queue, 250, 'a');
+
+	Poco::Timestamp start;
+	SIO_CHECK(!queue.waitForRoom(50));
+	SIO_CHECK(start.elapsed() >= 45000);
+	SIO_CHECK(!queue.waitForRoom(0));
+
+	Writer writer(queue);
+	Poco::Thread thread;
+	thread.start(writer);
+	SIO_CHECK(queue.waitForRoom(5000));
+	thread.join();
+	SIO_CHECK(queue.takeDrained());
+
+	//closing wakes the waiters up with false
+	pushBulk(queue, 250, 'b');
+	queue.close();
+	SIO_CHECK(!queue.waitForRoom(5000));
+}
+
+//dropping the queue above high counts as draining and wakes the writer
+static void testClearDrains()
+{
+	SIOSendQueue queue;
+	queue.setWatermarks(100, 10);
+	pushBulk(queue, 250, 'a');
+	SIO_CHECK(queue.aboveHigh());
+	SIO_CHECK_EQUAL(1u, queue.clear());
+	SIO_CHECK(!queue.aboveHigh());
+	SIO_CHECK_EQUAL(0u, queue.bytes());
+
+	//the writer wakes up with an empty batch to report the drain
+	std::vector<SIOSendQueue::Frame> batch;
+	SIO_CHECK(queue.pop(batch, 1000));
+	SIO_CHECK(batch.empty());
+	SIO_CHECK(queue.takeDrained());
+	SIO_CHECK(!queue.takeDrained());
+
+	//below high a clear is no drain
+	pushBulk(queue, 50, 'b');
+	SIO_CHECK_EQUAL(1u, queue.clear());
+	SIO_CHECK(!queue.takeDrained());
+}
+
+int main(int argc, char* argv[])
+{
+	testLanes();
+	testCoalescing();
+	testWatermarks();
+	testHardCap();
+	testClearDrains();
+	return SIO_TEST_RESULT();
+}
@@ -0,0 +1,581 @@
+// sio_loadgen.cpp : drives many SIOClient connections and namespaces against a server, to see how the client scales
+//
+// usage: sio_loadgen [--url <url>] [--clients <n>[,<n>...]] [--namespaces <m>] [--join <fraction>] [--emitters <fraction>]
+//                    [--rate <emits/s>] [--size <bytes>] [--size-dist fixed|uniform|exponential] [--event <name>]
+//                    [--ramp <clients/s>] [--threads <n>] [--seconds <s>] [--seed <n>] [--async] [--metrics]
+//
+// The flow of src/examples/main.cpp, made repeatable: every client opens a
+// connection, joins namespaces /load0 to /load<m-1>, listens to <event> on
+// them and emits it, for --seconds. Each count of --clients is a step of its
+// own, connected from scratch and disconnected at the end, so one run gives
+// a scaling table. The server is typically src/tools/sio_test_server:
+//
+//   echo       every emit comes back, latency is the round trip
+//   broadcast  every emit reaches the clients of its namespace
+//   flood      the server emits, run with --rate 0 to only receive
+//
+// Subscriptions are drawn from --seed: each client joins each namespace with
+// probability --join (at least one) and emits on each joined namespace with
+// probability --emitters, at --rate emits per second. Payload sizes follow
+// --size-dist around a mean of --size bytes. Emits carry their send time and
+// so do flood events, the latency of a received event is measured against it.
+//
+// The registry shares one socket per host and port, so the clients of a
+// loopback server each connect to an address of their own in 127.0.0.0/8,
+// which Linux routes to lo. Other servers get a single client.
+//
+// Every second it prints the emit and receive rates, the latency percentiles
+// of that second, the resident set size and the thread count of the process.
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Poco/Random.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include "Poco/URI.h"
+
+#include "SIOClient.h"
+#include "SIOConfig.h"
+#include "SIOHistogram.h"
+#include "SIOMetrics.h"
+
+struct Options
+{
+	enum SizeDist
+	{
+		FIXED,
+		UNIFORM,//0 to twice the size
+		EXPONENTIAL//capped at 16 times the size
+	};
+
+	Options() : url("http://127.0.0.1:3000"), namespaces(4), join(1), emitters(1), rate(10), size(64), sizeDist(FIXED),
+		event("load"), ramp(0), threads(8), seconds(10), seed(1), metrics(false) {};
+
+	std::string url;
+	std::vector<int> clients;
+	int namespaces;
+	double join;
+	double emitters;
+	double rate;//emits per second and emitting namespace
+	std::size_t size;
+	SizeDist sizeDist;
+	std::string event;
+	double ramp;//clients connected per second, 0 as fast as possible
+	int threads;//connecting, emitting and disconnecting threads
+	long seconds;
+	Poco::UInt32 seed;
+	bool metrics;
+	SIOConfig config;
+};
+
+struct Stats
+{
+	Stats() : connected(0), failed(0), sent(0), rejected(0), received(0) {};
+
+	std::atomic<Poco::UInt64> connected;
+	std::atomic<Poco::UInt64> failed;
+	std::atomic<Poco::UInt64> sent;
+	std::atomic<Poco::UInt64> rejected;//emit returned false
+	std::atomic<Poco::UInt64> received;
+	SIOHistogram latency;//of the whole step
+	SIOHistogram second;//reset by every report
+};
+
+//a step of the experiment, as printed in the final table
+struct Step
+{
+	int clients;
+	Poco::UInt64 connected;
+	double connectRate;
+	double joinSeconds;
+	double sentRate;
+	double receivedRate;
+	double p50, p99, p999, max;//milliseconds
+	double rssMB;
+	int threads;
+};
+
+struct Client
+{
+	std::string url;//scheme, host and port, without path
+	std::vector<std::string> namespaces;
+	std::vector<bool> emitting;
+	std::vector<SIOClient *> joined;
+};
+
+class LatencyTarget : public SIOEventTarget
+{
+public:
+	LatencyTarget(Stats &stats) : _stats(stats) {};
+
+	void onEvent(const void *pSender, Array::Ptr &args)
+	{
+		_stats.received.fetch_add(1, std::memory_order_relaxed);
+		if(args.isNull() || args->size() == 0)
+			return;
+
+		//"<ts>,<padding>" from our own emits, {"ts":...} from a flood
+		Poco::Int64 ts = 0;
+		if(args->isObject(0))
+		{
+			Poco::JSON::Object::Ptr o = args->getObject(0);
+			if(o->has("ts"))
+				ts = o->getValue<Poco::Int64>("ts");
+		}
+		else
+			ts = strtoll(args->get(0).toString().c_str(), NULL, 10);
+		if(ts <= 0)
+			return;
+
+		Poco::Int64 latency = Poco::Timestamp().epochMicroseconds() - ts;
+		_stats.latency.record(latency);
+		_stats.second.record(latency);
+	};
+
+private:
+	Stats &_stats;
+};
+
+//resident set size in kB and thread count of the process, 0 where /proc is missing
+static void processStatus(long &rssKB, int &threads)
+{
+	rssKB = 0;
+	threads = 0;
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line))
+	{
+		if(line.compare(0, 6, "VmRSS:") == 0)
+			rssKB = atol(line.c_str() + 6);
+		else if(line.compare(0, 8, "Threads:") == 0)
+			threads = atoi(line.c_str() + 8);
+	}
+}
+
+//scheme://host:port of the index-th client
+static std::string clientUrl(const Poco::URI &uri, int index)
+{
+	std::stringstream ss;
+	ss << uri.getScheme() << "://";
+	if(uri.getHost() == "localhost" || uri.getHost().compare(0, 4, "127.") == 0)
+	{
+		Poco::UInt32 address = 0x7F000001 + (Poco::UInt32)index;
+		ss << (address >> 24) << "." << ((address >> 16) & 0xFF) << "." << ((address >> 8) & 0xFF) << "." << (address & 0xFF);
+	}
+	else
+		ss << uri.getHost();
+	ss << ":" << uri.getPort();
+	return ss.str();
+}
+
+class Connector : public Poco::Runnable
+{
+public:
+	Connector(std::vector<Client> &clients, std::atomic<int> &next, const Options &options, Stats &stats, LatencyTarget &target, Poco::Timestamp &start) :
+		_clients(clients), _next(next), _options(options), _stats(stats), _target(target), _start(start) {};
+
+	void run()
+	{
+		int i;
+		while((i = _next.fetch_add(1)) < (int)_clients.size())
+		{
+			if(_options.ramp > 0)
+			{
+				Poco::Timestamp::TimeDiff ahead = (Poco::Timestamp::TimeDiff)(i / _options.ramp * 1e6) - _start.elapsed();
+				if(ahead > 1000)
+					Poco::Thread::sleep((long)(ahead / 1000));
+			}
+
+			Client &c = _clients[i];
+			for(std::size_t n = 0; n < c.namespaces.size(); ++n)
+			{
+				//the first namespace opens the connection, the others join it
+				SIOClient *client = SIOClient::connect(c.url + c.namespaces[n], _options.config);
+				if(!client)
+					break;
+				client->on(_options.event.c_str(), &_target, callback(&LatencyTarget::onEvent));
+				c.joined.push_back(client);
+			}
+			if(c.joined.empty())
+				_stats.failed.fetch_add(1, std::memory_order_relaxed);
+			else
+				_stats.connected.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+private:
+	std::vector<Client> &_clients;
+	std::atomic<int> &_next;
+	const Options &_options;
+	Stats &_stats;
+	LatencyTarget &_target;
+	Poco::Timestamp &_start;
+};
+
+class Emitter : public Poco::Runnable
+{
+public:
+	Emitter(std::vector<Client> &clients, int index, const Options &options, Stats &stats, std::atomic<bool> &running) :
+		_options(options), _stats(stats), _running(running), _random()
+	{
+		_random.seed(options.seed + index);
+		for(std::size_t i = index; i < clients.size(); i += options.threads)
+			for(std::size_t n = 0; n < clients[i].joined.size(); ++n)
+				if(clients[i].emitting[n])
+					_emitters.push_back(clients[i].joined[n]);
+		_padding.assign(options.size * 16, 'x');
+	};
+
+	void run()
+	{
+		if(_emitters.empty() || _options.rate <= 0)
+			return;
+
+		double rate = _options.rate * _emitters.size();
+		//a second late at most, then emits are skipped rather than burst
+		Poco::UInt64 burst = (Poco::UInt64)rate + 1;
+		Poco::UInt64 emitted = 0;
+		std::size_t turn = 0;
+		Poco::Timestamp start;
+		while(_running.load(std::memory_order_relaxed))
+		{
+			Poco::UInt64 due = (Poco::UInt64)(start.elapsed() / 1e6 * rate);
+			if(due > emitted + burst)
+				emitted = due - burst;
+			if(emitted >= due)
+			{
+				Poco::Thread::sleep(1);
+				continue;
+			}
+			for(; emitted < due; ++emitted)
+			{
+				SIOClient *client = _emitters[turn++ % _emitters.size()];
+				std::stringstream payload;
+				payload << Poco::Timestamp().epochMicroseconds() << ",";
+				payload.write(_padding.data(), nextSize());
+				if(client->emit(_options.event, payload.str()))
+					_stats.sent.fetch_add(1, std::memory_order_relaxed);
+				else
+					_stats.rejected.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+private:
+	std::size_t nextSize()
+	{
+		std::size_t size = _options.size;
+		switch(_options.sizeDist)
+		{
+		case Options::UNIFORM:
+			size = (std::size_t)(_random.nextDouble() * 2 * _options.size);
+			break;
+		case Options::EXPONENTIAL:
+			size = (std::size_t)(-log(1 - _random.nextDouble()) * _options.size);
+			break;
+		default:
+			break;
+		}
+		return size < _padding.size() ? size : _padding.size();
+	};
+
+	const Options &_options;
+	Stats &_stats;
+	std::atomic<bool> &_running;
+	Poco::Random _random;
+	std::vector<SIOClient *> _emitters;
+	std::string _padding;
+};
+
+class Disconnector : public Poco::Runnable
+{
+public:
+	Disconnector(std::vector<Client> &clients, std::atomic<int> &next) : _clients(clients), _next(next) {};
+
+	void run()
+	{
+		int i;
+		//the socket goes with the last namespace
+		while((i = _next.fetch_add(1)) < (int)_clients.size())
+			for(std::size_t n = 0; n < _clients[i].joined.size(); ++n)
+				_clients[i].joined[n]->disconnect();
+	};
+
+private:
+	std::vector<Client> &_clients;
+	std::atomic<int> &_next;
+};
+
+//runs one of each runnable on a thread of its own and waits for them
+template <class R>
+static void runAll(std::vector<R *> &runnables)
+{
+	std::vector<Poco::Thread *> threads;
+	for(std::size_t i = 0; i < runnables.size(); ++i)
+	{
+		threads.push_back(new Poco::Thread);
+		threads.back()->start(*runnables[i]);
+	}
+	for(std::size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i]->join();
+		delete threads[i];
+		delete runnables[i];
+	}
+	runnables.clear();
+}
+
+static double ms(Poco::UInt64 micros)
+{
+	return micros / 1000.0;
+}
+
+static Step runStep(int count, const Options &options)
+{
+	Step step;
+	step.clients = count;
+
+	Poco::URI uri(options.url);
+	Poco::Random random;
+	random.seed(options.seed);
+	std::vector<Client> clients(count);
+	std::size_t subscriptions = 0;
+	for(int i = 0; i < count; ++i)
+	{
+		Client &c = clients[i];
+		c.url = clientUrl(uri, i);
+		for(int n = 0; n < options.namespaces; ++n)
+		{
+			//every client keeps one namespace, spread evenly
+			if(n != i % options.namespaces && random.nextDouble() >= options.join)
+				continue;
+			std::stringstream ss;
+			ss << "/load" << n;
+			c.namespaces.push_back(ss.str());
+			c.emitting.push_back(random.nextDouble() < options.emitters);
+		}
+		subscriptions += c.namespaces.size();
+	}
+
+	Stats stats;
+	LatencyTarget target(stats);
+
+	//connect
+	std::atomic<int> next(0);
+	Poco::Timestamp start;
+	std::vector<Connector *> connectors;
+	for(int t = 0; t < options.threads; ++t)
+		connectors.push_back(new Connector(clients, next, options, stats, target, start));
+	runAll(connectors);
+	double connectSeconds = start.elapsed() / 1e6;
+	step.connected = stats.connected.load();
+	step.connectRate = step.connected / connectSeconds;
+
+	//namespaces joined once the server acknowledged them
+	std::size_t joined = 0, pending = 0;
+	for(std::size_t i = 0; i < clients.size(); ++i)
+		pending += clients[i].joined.size();
+	while(start.elapsed() < (connectSeconds + 10) * 1e6)
+	{
+		joined = 0;
+		for(std::size_t i = 0; i < clients.size(); ++i)
+			for(std::size_t n = 0; n < clients[i].joined.size(); ++n)
+				joined += clients[i].joined[n]->isConnected() ? 1 : 0;
+		if(joined == pending)
+			break;
+		Poco::Thread::sleep(10);
+	}
+	step.joinSeconds = start.elapsed() / 1e6;
+
+	long rssKB;
+	int threadCount;
+	processStatus(rssKB, threadCount);
+	printf("%d clients: %llu connected, %llu failed in %.2f s (%.0f/s), %lu of %lu namespaces joined after %.2f s, %.1f MB, %d threads\n",
+		count, (unsigned long long)step.connected, (unsigned long long)stats.failed.load(), connectSeconds, step.connectRate,
+		(unsigned long)joined, (unsigned long)subscriptions, step.joinSeconds, rssKB / 1024.0, threadCount);
+
+	//emit
+	std::atomic<bool> running(true);
+	std::vector<Emitter *> emitters;
+	for(int t = 0; t < options.threads; ++t)
+		emitters.push_back(new Emitter(clients, t, options, stats, running));
+	std::vector<Poco::Thread *> threads;
+	for(std::size_t t = 0; t < emitters.size(); ++t)
+	{
+		threads.push_back(new Poco::Thread);
+		threads.back()->start(*emitters[t]);
+	}
+
+	printf("%6s %10s %10s %10s %10s %10s %10s %8s %8s\n", "s", "sent/s", "recv/s", "rejected", "p50 ms", "p99 ms", "p999 ms", "RSS MB", "threads");
+	Poco::Timestamp emitStart;
+	Poco::UInt64 sent = 0, received = 0, rejected = 0;
+	step.rssMB = 0;
+	step.threads = 0;
+	for(long s = 1; s <= options.seconds; ++s)
+	{
+		Poco::Timestamp::TimeDiff ahead = s * 1000000 - emitStart.elapsed();
+		if(ahead > 0)
+			Poco::Thread::sleep((long)(ahead / 1000));
+
+		Poco::UInt64 nowSent = stats.sent.load(), nowReceived = stats.received.load(), nowRejected = stats.rejected.load();
+		processStatus(rssKB, threadCount);
+		step.rssMB = rssKB / 1024.0 > step.rssMB ? rssKB / 1024.0 : step.rssMB;
+		step.threads = threadCount > step.threads ? threadCount : step.threads;
+		printf("%6ld %10llu %10llu %10llu %10.3f %10.3f %10.3f %8.1f %8d\n", s,
+			(unsigned long long)(nowSent - sent), (unsigned long long)(nowReceived - received), (unsigned long long)(nowRejected - rejected),
+			ms(stats.second.percentile(50)), ms(stats.second.percentile(99)), ms(stats.second.percentile(99.9)),
+			rssKB / 1024.0, threadCount);
+		stats.second.reset();
+		sent = nowSent;
+		received = nowReceived;
+		rejected = nowRejected;
+	}
+	running.store(false);
+	double emitSeconds = emitStart.elapsed() / 1e6;
+	for(std::size_t t = 0; t < threads.size(); ++t)
+	{
+		threads[t]->join();
+		delete threads[t];
+		delete emitters[t];
+	}
+	step.sentRate = stats.sent.load() / emitSeconds;
+	step.receivedRate = stats.received.load() / emitSeconds;
+	step.p50 = ms(stats.latency.percentile(50));
+	step.p99 = ms(stats.latency.percentile(99));
+	step.p999 = ms(stats.latency.percentile(99.9));
+	step.max = ms(stats.latency.max());
+
+	if(options.metrics)
+		std::cout << SIOMetrics::instance()->renderPrometheus();
+
+	//disconnect
+	next.store(0);
+	Poco::Timestamp stop;
+	std::vector<Disconnector *> disconnectors;
+	for(int t = 0; t < options.threads; ++t)
+		disconnectors.push_back(new Disconnector(clients, next));
+	runAll(disconnectors);
+	printf("%d clients disconnected in %.2f s\n\n", count, stop.elapsed() / 1e6);
+	return step;
+}
+
+static bool parseClients(const std::string &value, std::vector<int> &clients)
+{
+	std::stringstream ss(value);
+	std::string item;
+	while(std::getline(ss, item, ','))
+	{
+		int count = atoi(item.c_str());
+		if(count <= 0)
+			return false;
+		clients.push_back(count);
+	}
+	return !clients.empty();
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if(arg == "--url" && hasValue)
+			options.url = argv[++i];
+		else if(arg == "--clients" && hasValue)
+		{
+			if(!parseClients(argv[++i], options.clients))
+			{
+				std::cerr << "--clients takes counts separated by commas" << std::endl;
+				return 1;
+			}
+		}
+		else if(arg == "--namespaces" && hasValue)
+			options.namespaces = atoi(argv[++i]);
+		else if(arg == "--join" && hasValue)
+			options.join = atof(argv[++i]);
+		else if(arg == "--emitters" && hasValue)
+			options.emitters = atof(argv[++i]);
+		else if(arg == "--rate" && hasValue)
+			options.rate = atof(argv[++i]);
+		else if(arg == "--size" && hasValue)
+			options.size = (std::size_t)atol(argv[++i]);
+		else if(arg == "--size-dist" && hasValue)
+		{
+			std::string value = argv[++i];
+			if(value == "fixed")
+				options.sizeDist = Options::FIXED;
+			else if(value == "uniform")
+				options.sizeDist = Options::UNIFORM;
+			else if(value == "exponential")
+				options.sizeDist = Options::EXPONENTIAL;
+			else
+			{
+				std::cerr << "unknown size distribution " << value << std::endl;
+				return 1;
+			}
+		}
+		else if(arg == "--event" && hasValue)
+			options.event = argv[++i];
+		else if(arg == "--ramp" && hasValue)
+			options.ramp = atof(argv[++i]);
+		else if(arg == "--threads" && hasValue)
+			options.threads = atoi(argv[++i]);
+		else if(arg == "--seconds" && hasValue)
+			options.seconds = atol(argv[++i]);
+		else if(arg == "--seed" && hasValue)
+			options.seed = (Poco::UInt32)atol(argv[++i]);
+		else if(arg == "--async")
+			options.config.asyncDispatch = true;
+		else if(arg == "--metrics")
+			options.metrics = true;
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--url <url>] [--clients <n>[,<n>...]] [--namespaces <m>] [--join <fraction>] [--emitters <fraction>]" << std::endl
+				<< "       [--rate <emits/s>] [--size <bytes>] [--size-dist fixed|uniform|exponential] [--event <name>]" << std::endl
+				<< "       [--ramp <clients/s>] [--threads <n>] [--seconds <s>] [--seed <n>] [--async] [--metrics]" << std::endl;
+			return 1;
+		}
+	}
+	if(options.clients.empty())
+		options.clients.push_back(100);
+	if(options.namespaces < 1 || options.threads < 1)
+	{
+		std::cerr << "--namespaces and --threads must be at least 1" << std::endl;
+		return 1;
+	}
+
+	//clients come and go with each step, a dropped connection is a result
+	options.config.reconnection = false;
+
+	Poco::URI uri(options.url);
+	if(uri.getHost() != "localhost" && uri.getHost().compare(0, 4, "127.") != 0)
+	{
+		for(std::size_t i = 0; i < options.clients.size(); ++i)
+			options.clients[i] = 1;
+		std::cerr << options.url << " is not a loopback address, running a single client per step" << std::endl;
+	}
+
+	std::vector<Step> steps;
+	for(std::size_t i = 0; i < options.clients.size(); ++i)
+		steps.push_back(runStep(options.clients[i], options));
+
+	printf("%8s %9s %9s %9s %10s %10s %9s %9s %9s %9s %8s %8s\n", "clients", "connected", "conn/s", "joined s",
+		"sent/s", "recv/s", "p50 ms", "p99 ms", "p999 ms", "max ms", "RSS MB", "threads");
+	for(std::size_t i = 0; i < steps.size(); ++i)
+	{
+		Step &s = steps[i];
+		printf("%8d %9llu %9.0f %9.2f %10.0f %10.0f %9.3f %9.3f %9.3f %9.3f %8.1f %8d\n", s.clients, (unsigned long long)s.connected,
+			s.connectRate, s.joinSeconds, s.sentRate, s.receivedRate, s.p50, s.p99, s.p999, s.max, s.rssMB, s.threads);
+	}
+	return 0;
+}
@@ -0,0 +1,347 @@
+// sio_replay.cpp : feeds a capture written by SIOCapture through the decode and dispatch path of the library, without network
+//
+// usage: sio_replay <capture file> [--speed <factor>] [--loops <n>] [--namespace <name>] [--async] [--metrics]
+//
+// The frames received by every captured connection are replayed in order, as
+// fast as possible or, with --speed, at the recorded pace scaled by the factor
+// (1 for real time). Each connection gets a socket from SIOClientImpl::replay
+// and a client per namespace seen in its frames, with a counting handler on
+// every event name, so decode, dispatch and the handler lookup all run as
+// they would live. --namespace only replays the frames of one namespace.
+// Throughput and the event latency percentiles are printed at the end,
+// --metrics adds the Prometheus text of SIOMetrics.
+//
+// Records carry the namespace of their frame, only event names are read from
+// the frames. Captures of version 1 had no namespaces, they are found by
+// scanning the frame headers.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include "Poco/URI.h"
+
+#include "SIOCapture.h"
+#include "SIOClient.h"
+#include "SIOClientImpl.h"
+#include "SIOClientRegistry.h"
+#include "SIOFrameScanner.h"
+#include "SIOJSON.h"
+#include "SIOLatency.h"
+#include "SIOMetrics.h"
+
+struct Frame
+{
+	Poco::UInt64 timestamp;
+	Poco::UInt32 connection;
+	int flags;
+	Poco::UInt16 endpoint;
+	std::string data;
+};
+
+//a captured connection and what it is replayed with
+struct Connection
+{
+	Connection() : version(SocketIOPacket::V10x), socket(NULL) {};
+
+	SocketIOPacket::SocketIOVersion version;
+	std::string uri;
+	std::set<std::string> endpoints;
+	std::set<std::string> events;
+	SIOClientImpl *socket;
+	std::vector<SIOClient *> clients;
+};
+
+class CountingTarget : public SIOEventTarget
+{
+public:
+	CountingTarget() : handled(0) {};
+
+	void onEvent(const void *pSender, Array::Ptr &args) {handled.fetch_add(1, std::memory_order_relaxed);};
+
+	std::atomic<Poco::UInt64> handled;
+};
+
+//event name of a received frame, and its namespace for captures without
+//namespace ids. False for control frames
+static bool scanFrame(Connection &c, const std::string &frame, bool scanEndpoint)
+{
+	SIOFrameHeader header;
+	if(c.version == SocketIOPacket::V10x)
+	{
+		if(!SIOFrameScanner::parseV10x(frame.data(), frame.size(), header) || header.type != 4)
+			return false;
+		if(scanEndpoint)
+			c.endpoints.insert(std::string(header.endpoint, header.endpointSize));
+		if(header.subtype != 2)
+			return true;
+	}
+	else
+	{
+		if(!SIOFrameScanner::parseV09x(frame.data(), frame.size(), header))
+			return false;
+		if(scanEndpoint)
+			c.endpoints.insert(std::string(header.endpoint, header.endpointSize));
+		if(header.type == 3 || header.type == 4)
+			c.events.insert("message");
+		if(header.type != 5)
+			return true;
+	}
+
+	SocketIOPacket *packet = SocketIOPacket::createPacketWithType("event", c.version);
+	if(SIOJSON::parseEvent(std::string(header.payload, header.payloadSize), c.version, packet))
+		c.events.insert(packet->getEvent());
+	delete packet;
+	return true;
+}
+
+static bool readCapture(const char *path, std::vector<Frame> &frames, std::map<Poco::UInt32, Connection> &connections,
+	std::map<Poco::UInt16, std::string> &endpoints, Poco::UInt32 &version, std::size_t &sent)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+	{
+		std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+
+	SIOCaptureHeader header;
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "SIOCAPTR", 8) != 0)
+	{
+		std::cerr << path << " is not a capture file" << std::endl;
+		fclose(f);
+		return false;
+	}
+	version = header.version;
+	if((version != 1 && version != 2) || header.recordSize != sizeof(SIOCaptureRecord))
+	{
+		std::cerr << "unsupported capture version " << header.version << " (record of " << header.recordSize << " bytes)" << std::endl;
+		fclose(f);
+		return false;
+	}
+
+	SIOCaptureRecord r;
+	while(fread(&r, sizeof(r), 1, f) == 1)
+	{
+		std::string data(r.length, '\0');
+		if(r.length > 0 && fread(&data[0], 1, r.length, f) != r.length)
+		{
+			std::cerr << "truncated capture, replaying what was read" << std::endl;
+			break;
+		}
+
+		Connection &c = connections[r.connection];
+		switch(r.type)
+		{
+		case SIOCapture::OPEN:
+			c.version = data.compare(0, 4, "0.9 ") == 0 ? SocketIOPacket::V09x : SocketIOPacket::V10x;
+			c.uri = data.size() > 4 ? data.substr(4) : std::string();
+			break;
+		case SIOCapture::ENDPOINT:
+			endpoints[r.endpoint] = data;
+			break;
+		case SIOCapture::IN:
+		{
+			Frame frame;
+			frame.timestamp = r.timestamp;
+			frame.connection = r.connection;
+			frame.flags = r.flags;
+			//the field was reserved, 0, in version 1
+			frame.endpoint = r.endpoint;
+			frame.data.swap(data);
+			frames.push_back(frame);
+		}	break;
+		default:
+			++sent;
+			break;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+static double percentileMs(const std::string &name, SIOLatency::Stage stage, double percent)
+{
+	SIOHistogram h;
+	SIOLatency::instance()->collect(name, stage, h);
+	return h.percentile(percent) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <capture file> [--speed <factor>] [--loops <n>] [--namespace <name>] [--async] [--metrics]" << std::endl;
+		return 1;
+	}
+
+	double speed = 0;
+	int loops = 1;
+	bool metrics = false;
+	bool filtered = false;
+	std::string only;
+	SIOConfig config;
+	config.reconnection = false;
+	//offsets repeat with every --loops pass, recovery would drop them as seen
+	config.stateRecovery = false;
+	for(int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "--speed" && i + 1 < argc)
+			speed = atof(argv[++i]);
+		else if(arg == "--loops" && i + 1 < argc)
+			loops = atoi(argv[++i]);
+		else if(arg == "--namespace" && i + 1 < argc)
+		{
+			filtered = true;
+			only = argv[++i];
+		}
+		else if(arg == "--async")
+			config.asyncDispatch = true;
+		else if(arg == "--metrics")
+			metrics = true;
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Frame> frames;
+	std::map<Poco::UInt32, Connection> connections;
+	std::map<Poco::UInt16, std::string> endpoints;
+	Poco::UInt32 version = 0;
+	std::size_t sent = 0;
+	if(!readCapture(argv[1], frames, connections, endpoints, version, sent))
+		return 1;
+	if(filtered)
+	{
+		if(version < 2)
+		{
+			std::cerr << "--namespace needs a capture of version 2 or later" << std::endl;
+			return 1;
+		}
+		std::vector<Frame> kept;
+		for(std::size_t i = 0; i < frames.size(); ++i)
+			if(frames[i].endpoint != SIOCapture::NO_ENDPOINT && endpoints[frames[i].endpoint] == only)
+				kept.push_back(frames[i]);
+		frames.swap(kept);
+	}
+	if(frames.empty())
+	{
+		std::cerr << "no received frames in " << argv[1] << std::endl;
+		return 1;
+	}
+
+	for(std::size_t i = 0; i < frames.size(); ++i)
+	{
+		Connection &c = connections[frames[i].connection];
+		if(version < 2)
+			scanFrame(c, frames[i].data, true);
+		else if(frames[i].endpoint != SIOCapture::NO_ENDPOINT)
+		{
+			c.endpoints.insert(endpoints[frames[i].endpoint]);
+			scanFrame(c, frames[i].data, false);
+		}
+	}
+
+	//a socket per captured connection, on its own host so that their
+	//namespaces do not collide in the registry
+	CountingTarget target;
+	for(std::map<Poco::UInt32, Connection>::iterator it = connections.begin(); it != connections.end(); ++it)
+	{
+		Connection &c = it->second;
+		char host[64];
+		snprintf(host, sizeof(host), "http://replay-%u:80", (unsigned)it->first);
+		if(c.uri.empty())
+			std::cerr << "connection " << it->first << " was not opened in the capture, replaying it as 1.0" << std::endl;
+
+		Poco::URI uri(host);
+		//registered with a reference held, from then on its clients keep it
+		Poco::AutoPtr<SIOClientImpl> socket(SIOClientImpl::replay(uri, c.version, config), true);
+		c.socket = socket;
+		SIOClientRegistry::instance()->addSocket(socket, uri.getHost() + ":80");
+
+		c.endpoints.insert("");
+		for(std::set<std::string>::iterator e = c.endpoints.begin(); e != c.endpoints.end(); ++e)
+		{
+			//under the uri handleFrame looks the endpoint up with
+			const std::string &endpoint = *e;
+			if(SIOClientRegistry::instance()->getClient(uri.getHost() + ":80" + endpoint))
+				continue;
+			SIOClient *client = new SIOClient(uri.getHost() + ":80" + endpoint, endpoint, c.socket);
+			SIOClientRegistry::instance()->addClient(client);
+			for(std::set<std::string>::iterator n = c.events.begin(); n != c.events.end(); ++n)
+				client->on(n->c_str(), &target, callback(&CountingTarget::onEvent));
+			c.clients.push_back(client);
+		}
+	}
+
+	std::size_t bytes = 0;
+	std::vector<SIOClientImpl *> sockets(frames.size());
+	for(std::size_t i = 0; i < frames.size(); ++i)
+	{
+		bytes += frames[i].data.size();
+		sockets[i] = connections[frames[i].connection].socket;
+	}
+
+	std::cout << "replaying " << frames.size() << " frames (" << bytes << " bytes) of " << connections.size()
+		<< " connections, " << sent << " sent frames skipped" << std::endl;
+
+	Poco::Timestamp start;
+	for(int loop = 0; loop < loops; ++loop)
+	{
+		Poco::Timestamp pass;
+		for(std::size_t i = 0; i < frames.size(); ++i)
+		{
+			Frame &frame = frames[i];
+			if(speed > 0)
+			{
+				Poco::Timestamp::TimeDiff due = (Poco::Timestamp::TimeDiff)((frame.timestamp - frames[0].timestamp) / speed);
+				Poco::Timestamp::TimeDiff ahead = due - pass.elapsed();
+				if(ahead > 1000)
+					Poco::Thread::sleep((long)(ahead / 1000));
+			}
+			sockets[i]->replayFrame(frame.data.data(), frame.data.size(), frame.flags);
+		}
+	}
+	//the dispatch threads of asyncDispatch may still be working
+	for(std::map<Poco::UInt32, Connection>::iterator it = connections.begin(); it != connections.end(); ++it)
+		while(it->second.socket->getInboundStats().events > 0)
+			Poco::Thread::sleep(1);
+	double seconds = start.elapsed() / 1e6;
+
+	std::size_t replayed = frames.size() * loops;
+	printf("%lu frames in %.3f s: %.0f frames/s, %.1f MB/s, %llu events handled\n",
+		(unsigned long)replayed, seconds, replayed / seconds, bytes * (double)loops / seconds / 1e6,
+		(unsigned long long)target.handled.load());
+
+	std::vector<std::string> names;
+	SIOLatency::instance()->names(names);
+	printf("%-24s %10s %10s %10s %10s %10s\n", "event (ms)", "count", "decode p99", "total p50", "total p99", "total p999");
+	for(std::size_t i = 0; i < names.size(); ++i)
+	{
+		SIOHistogram total;
+		SIOLatency::instance()->collect(names[i], SIOLatency::TOTAL, total);
+		printf("%-24s %10llu %10.3f %10.3f %10.3f %10.3f\n", names[i].c_str(), (unsigned long long)total.count(),
+			percentileMs(names[i], SIOLatency::DECODE, 99),
+			total.percentile(50) / 1000.0, total.percentile(99) / 1000.0, total.percentile(99.9) / 1000.0);
+	}
+
+	if(metrics)
+		std::cout << SIOMetrics::instance()->renderPrometheus();
+
+	//the sockets go with their last client
+	for(std::map<Poco::UInt32, Connection>::iterator it = connections.begin(); it != connections.end(); ++it)
+		for(std::size_t i = 0; i < it->second.clients.size(); ++i)
+			it->second.clients[i]->disconnect();
+	return 0;
+}
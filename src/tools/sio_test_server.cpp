@@ -0,0 +1,496 @@
+// sio_test_server.cpp : a small Socket.IO server on Poco Net, so tests and benchmarks do not need node and examples/server.js
+//
+// usage: sio_test_server [--port <port>] [--protocol 1.0|0.9] [--mode echo|broadcast|flood|sink]
+//                        [--rate <events/s>] [--size <bytes>] [--event <name>] [--max-connections <n>] [--seconds <s>]
+//
+// It speaks enough of either protocol for this client: the polling handshake,
+// the websocket upgrade, namespace connects and disconnects, heartbeats
+// (ping/pong on 1.0), events, messages and acks. Events with an ack id are
+// acknowledged with their own arguments, the others are handled by the mode:
+//
+//   echo       sent back to the client
+//   broadcast  sent to every client in the namespace, the sender included
+//   flood      ignored, every connected namespace instead gets <rate> events
+//              per second named <event>, with {"seq":n,"ts":<epoch us>,"data":"<size bytes>"}
+//   sink       ignored
+//
+// Every connection has a thread of its own, --max-connections sizes the pool.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Poco/Buffer.h"
+#include "Poco/Mutex.h"
+#include "Poco/Random.h"
+#include "Poco/String.h"
+#include "Poco/Thread.h"
+#include "Poco/ThreadPool.h"
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/Net/HTTPServer.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/HTTPServerRequest.h"
+#include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/Net/WebSocket.h"
+
+#include "SIOFrameScanner.h"
+
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPServer;
+using Poco::Net::HTTPServerParams;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::Net::ServerSocket;
+using Poco::Net::Socket;
+using Poco::Net::WebSocket;
+
+struct Options
+{
+	enum Mode
+	{
+		ECHO,
+		BROADCAST,
+		FLOOD,
+		SINK
+	};
+
+	Options() : port(3000), v09x(false), mode(ECHO), rate(100), size(64), event("flood"), maxConnections(1024), seconds(0) {};
+
+	Poco::UInt16 port;
+	bool v09x;
+	Mode mode;
+	double rate;//flood events per second and namespace
+	std::size_t size;//flood payload bytes
+	std::string event;
+	int maxConnections;
+	long seconds;//0 runs until killed
+};
+
+static Options options;
+static std::atomic<long> connections(0);
+static std::atomic<Poco::UInt64> framesIn(0);
+static std::atomic<Poco::UInt64> framesOut(0);
+
+class Session
+{
+public:
+	Session(WebSocket &ws) : _ws(ws) {};
+
+	void send(const std::string &frame)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_ws.sendFrame(frame.data(), (int)frame.size());
+		++framesOut;
+	}
+
+	void join(const std::string &endpoint)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_endpoints.insert(endpoint);
+	}
+
+	void leave(const std::string &endpoint)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_endpoints.erase(endpoint);
+	}
+
+	bool joined(const std::string &endpoint)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		return _endpoints.count(endpoint) > 0;
+	}
+
+	void endpoints(std::vector<std::string> &endpoints)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		endpoints.assign(_endpoints.begin(), _endpoints.end());
+	}
+
+private:
+	WebSocket &_ws;
+	Poco::FastMutex _mutex;//one frame at a time, and the namespaces
+	std::set<std::string> _endpoints;
+};
+
+//every open session, for broadcasts
+class Sessions
+{
+public:
+	void add(Session *session)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_sessions.insert(session);
+	}
+
+	void remove(Session *session)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_sessions.erase(session);
+	}
+
+	//sessions are not removed meanwhile, a stuck one holds up the others
+	//until its send timeout
+	void broadcast(const std::string &endpoint, const std::string &frame)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		for(std::set<Session *>::iterator it = _sessions.begin(); it != _sessions.end(); ++it)
+		{
+			if(!(*it)->joined(endpoint))
+				continue;
+			try
+			{
+				(*it)->send(frame);
+			}
+			catch(Poco::Exception &e)
+			{
+			}
+		}
+	}
+
+private:
+	std::set<Session *> _sessions;
+	Poco::FastMutex _mutex;
+};
+
+static Sessions sessions;
+
+//frame of an event, data is [name, args...] on 1.0 and {"name":..,"args":[..]} on 0.9
+static std::string eventFrame(const std::string &endpoint, const std::string &data)
+{
+	if(options.v09x)
+		return "5::" + endpoint + ":" + data;
+	return "42" + (endpoint.empty() ? std::string() : endpoint + ",") + data;
+}
+
+//ack of an event, args is the JSON array of the ack arguments
+static std::string ackFrame(const std::string &endpoint, const std::string &id, const std::string &args)
+{
+	if(options.v09x)
+		return "6:::" + id + "+" + args;
+	return "43" + (endpoint.empty() ? std::string() : endpoint + ",") + id + args;
+}
+
+static std::string connectFrame(const std::string &endpoint)
+{
+	if(options.v09x)
+		return "1::" + endpoint;
+	return "40" + (endpoint.empty() ? std::string() : endpoint + ",");
+}
+
+static std::string floodFrame(const std::string &endpoint, Poco::UInt64 seq, const std::string &data)
+{
+	std::stringstream args;
+	args << "{\"seq\":" << seq << ",\"ts\":" << Poco::Timestamp().epochMicroseconds() << ",\"data\":\"" << data << "\"}";
+	if(options.v09x)
+		return eventFrame(endpoint, "{\"name\":\"" + options.event + "\",\"args\":[" + args.str() + "]}");
+	return eventFrame(endpoint, "[\"" + options.event + "\"," + args.str() + "]");
+}
+
+//an event the client sent: acked, echoed or broadcast
+static void handleEvent(Session &session, const std::string &endpoint, std::string id, const std::string &data)
+{
+	if(!id.empty())
+	{
+		if(id[id.size() - 1] == '+')
+			id.erase(id.size() - 1);
+		//the arguments: everything after the name on 1.0, the args member on 0.9
+		std::string args = "[]";
+		if(options.v09x)
+		{
+			std::size_t at = data.find("\"args\":");
+			if(at != std::string::npos && data.size() > at + 8)
+				args = data.substr(at + 7, data.size() - at - 8);
+		}
+		else
+		{
+			std::size_t comma = data.find(',');
+			if(comma != std::string::npos)
+				args = "[" + data.substr(comma + 1);
+		}
+		session.send(ackFrame(endpoint, id, args));
+		return;
+	}
+
+	if(options.mode == Options::ECHO)
+		session.send(eventFrame(endpoint, data));
+	else if(options.mode == Options::BROADCAST)
+		sessions.broadcast(endpoint, eventFrame(endpoint, data));
+}
+
+//false when the client is gone
+static bool handleFrame(Session &session, const char *data, std::size_t size)
+{
+	SIOFrameHeader header;
+	if(options.v09x)
+	{
+		if(!SIOFrameScanner::parseV09x(data, size, header))
+			return true;
+		std::string endpoint(header.endpoint, header.endpointSize);
+		std::string id(header.id, header.idSize);
+		switch(header.type)
+		{
+		case 0:
+			if(endpoint.empty())
+				return false;
+			session.leave(endpoint);
+			break;
+		case 1:
+			session.join(endpoint);
+			session.send(connectFrame(endpoint));
+			break;
+		case 2:
+			session.send("2::");
+			break;
+		case 3:
+		case 4:
+			if(options.mode == Options::ECHO)
+				session.send(std::string(data, size));
+			else if(options.mode == Options::BROADCAST)
+				sessions.broadcast(endpoint, std::string(data, size));
+			break;
+		case 5:
+			handleEvent(session, endpoint, id, std::string(header.payload, header.payloadSize));
+			break;
+		}
+		return true;
+	}
+
+	if(!SIOFrameScanner::parseV10x(data, size, header))
+		return true;
+	switch(header.type)
+	{
+	case 1:
+		return false;
+	case 2:
+		//ping, or the probe of the upgrade
+		session.send("3" + std::string(header.payload, header.payloadSize));
+		break;
+	case 4:
+	{
+		std::string endpoint(header.endpoint, header.endpointSize);
+		std::string id(header.id, header.idSize);
+		switch(header.subtype)
+		{
+		case 0:
+			session.join(endpoint);
+			session.send(connectFrame(endpoint));
+			break;
+		case 1:
+			session.leave(endpoint);
+			break;
+		case 2:
+			handleEvent(session, endpoint, id, std::string(header.payload, header.payloadSize));
+			break;
+		}
+	}	break;
+	}
+	return true;
+}
+
+class SocketIOHandler : public HTTPRequestHandler
+{
+public:
+	void handleRequest(HTTPServerRequest &request, HTTPServerResponse &response)
+	{
+		if(request.has("Upgrade") && Poco::icompare(request.get("Upgrade"), std::string("websocket")) == 0)
+			serveWebSocket(request, response);
+		else if(request.getURI().compare(0, 11, "/socket.io/") == 0)
+			handshake(response);
+		else
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+			response.setContentLength(0);
+			response.send();
+		}
+	}
+
+private:
+	void handshake(HTTPServerResponse &response)
+	{
+		char sid[32];
+		Poco::Random rnd;
+		rnd.seed();
+		snprintf(sid, sizeof(sid), "%08x%08x", rnd.next(), rnd.next());
+
+		std::string body;
+		if(options.v09x)
+			body = std::string(sid) + ":60:60:websocket";
+		else
+			body = std::string("0{\"sid\":\"") + sid + "\",\"upgrades\":[\"websocket\"],\"pingInterval\":25000,\"pingTimeout\":60000}";
+		response.setContentType("text/plain");
+		response.setContentLength((std::streamsize)body.size());
+		response.send() << body;
+	}
+
+	void serveWebSocket(HTTPServerRequest &request, HTTPServerResponse &response)
+	{
+		try
+		{
+			WebSocket ws(request, response);
+			ws.setSendTimeout(Poco::Timespan(5, 0));
+			Session session(ws);
+			sessions.add(&session);
+			++connections;
+			try
+			{
+				run(ws, session);
+			}
+			catch(Poco::Exception &e)
+			{
+			}
+			--connections;
+			sessions.remove(&session);
+		}
+		catch(Poco::Exception &e)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST);
+			response.setContentLength(0);
+			response.send();
+		}
+	}
+
+	void run(WebSocket &ws, Session &session)
+	{
+		//the default namespace is joined right away
+		session.join("");
+		session.send(connectFrame(""));
+
+		std::string data(options.size, 'x');
+		Poco::Timestamp floodStart;
+		Poco::UInt64 flooded = 0;
+		//poll often enough to keep the flood rate
+		Poco::Timespan interval(0, 100000);
+		if(options.mode == Options::FLOOD && options.rate > 0)
+		{
+			long us = (long)(1000000 / options.rate);
+			interval = Poco::Timespan(0, us < 1000 ? 1000 : (us > 100000 ? 100000 : us));
+		}
+
+		Poco::Buffer<char> buffer(0);
+		for(;;)
+		{
+			if(ws.poll(interval, Socket::SELECT_READ))
+			{
+				int flags;
+				buffer.resize(0);
+				int n = ws.receiveFrame(buffer, flags);
+				if(n <= 0 || (flags & WebSocket::FRAME_OP_BITMASK) == WebSocket::FRAME_OP_CLOSE)
+					return;
+				++framesIn;
+				if((flags & WebSocket::FRAME_OP_BITMASK) == WebSocket::FRAME_OP_PING)
+					continue;
+				if(!handleFrame(session, buffer.begin(), n))
+					return;
+			}
+
+			if(options.mode != Options::FLOOD)
+				continue;
+			//what the rate owes since the start, at most a tenth of a second worth at once
+			Poco::UInt64 due = (Poco::UInt64)(floodStart.elapsed() / 1e6 * options.rate);
+			Poco::UInt64 burst = (Poco::UInt64)(options.rate / 10) + 1;
+			if(due > flooded + burst)
+				flooded = due - burst;
+			std::vector<std::string> endpoints;
+			session.endpoints(endpoints);
+			for(; flooded < due; ++flooded)
+				for(std::size_t i = 0; i < endpoints.size(); ++i)
+					session.send(floodFrame(endpoints[i], flooded, data));
+		}
+	}
+};
+
+class SocketIOHandlerFactory : public HTTPRequestHandlerFactory
+{
+public:
+	HTTPRequestHandler *createRequestHandler(const HTTPServerRequest &request)
+	{
+		return new SocketIOHandler;
+	}
+};
+
+static bool parseOptions(int argc, char* argv[])
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		std::string value = i + 1 < argc ? argv[i + 1] : "";
+		if(arg == "--port" && !value.empty())
+			options.port = (Poco::UInt16)atoi(argv[++i]);
+		else if(arg == "--protocol" && !value.empty())
+		{
+			options.v09x = value == "0.9";
+			++i;
+		}
+		else if(arg == "--mode" && !value.empty())
+		{
+			if(value == "echo")
+				options.mode = Options::ECHO;
+			else if(value == "broadcast")
+				options.mode = Options::BROADCAST;
+			else if(value == "flood")
+				options.mode = Options::FLOOD;
+			else if(value == "sink")
+				options.mode = Options::SINK;
+			else
+				return false;
+			++i;
+		}
+		else if(arg == "--rate" && !value.empty())
+			options.rate = atof(argv[++i]);
+		else if(arg == "--size" && !value.empty())
+			options.size = (std::size_t)atol(argv[++i]);
+		else if(arg == "--event" && !value.empty())
+			options.event = argv[++i];
+		else if(arg == "--max-connections" && !value.empty())
+			options.maxConnections = atoi(argv[++i]);
+		else if(arg == "--seconds" && !value.empty())
+			options.seconds = atol(argv[++i]);
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if(!parseOptions(argc, argv))
+	{
+		std::cerr << "usage: " << argv[0] << " [--port <port>] [--protocol 1.0|0.9] [--mode echo|broadcast|flood|sink]" << std::endl
+			<< "       [--rate <events/s>] [--size <bytes>] [--event <name>] [--max-connections <n>] [--seconds <s>]" << std::endl;
+		return 1;
+	}
+
+	//a thread per websocket, with small stacks
+	Poco::ThreadPool pool(4, options.maxConnections + 4, 60, 256 * 1024);
+	HTTPServerParams *params = new HTTPServerParams;
+	params->setMaxThreads(options.maxConnections + 4);
+	params->setMaxQueued(options.maxConnections);
+	ServerSocket socket(options.port, 1024);
+	HTTPServer server(new SocketIOHandlerFactory, pool, socket, params);
+	server.start();
+	std::cout << "listening on port " << options.port << " (protocol " << (options.v09x ? "0.9" : "1.0") << ")" << std::endl;
+
+	for(long second = 1; options.seconds == 0 || second <= options.seconds; ++second)
+	{
+		Poco::Thread::sleep(1000);
+		if(second % 10 == 0 || second == options.seconds)
+			std::cout << connections.load() << " connections, " << framesIn.load() << " frames in, "
+				<< framesOut.load() << " frames out" << std::endl;
+	}
+	server.stopAll(true);
+	pool.joinAll();
+	return 0;
+}
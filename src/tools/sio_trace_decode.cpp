@@ -0,0 +1,99 @@
+// sio_trace_decode.cpp : prints a wire trace written by SIOTracer, one line per frame
+//
+// usage: sio_trace_decode <trace file> [connection]
+//
+// 2026-10-19 10:41:59.123456 #3 -> TEXT 42 42["position",{"x":1}]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include "SIOTrace.h"
+
+static const char *opcodeName(int flags)
+{
+	switch(flags & 0x0f)
+	{
+	case 0x0: return "CONT";
+	case 0x1: return "TEXT";
+	case 0x2: return "BINARY";
+	case 0x8: return "CLOSE";
+	case 0x9: return "PING";
+	case 0xa: return "PONG";
+	}
+	return "?";
+}
+
+//printable ascii as is, the rest as \xNN
+static std::string escape(const char *data, std::size_t size)
+{
+	std::string out;
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		unsigned char c = (unsigned char)data[i];
+		if(c >= 0x20 && c < 0x7f && c != '\\')
+			out += (char)c;
+		else
+		{
+			char hex[8];
+			snprintf(hex, sizeof(hex), "\\x%02x", c);
+			out += hex;
+		}
+	}
+	return out;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <trace file> [connection]" << std::endl;
+		return 1;
+	}
+	long only = argc > 2 ? atol(argv[2]) : -1;
+
+	FILE *f = fopen(argv[1], "rb");
+	if(!f)
+	{
+		std::cerr << "cannot open " << argv[1] << std::endl;
+		return 1;
+	}
+
+	SIOTraceHeader header;
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "SIOTRACE", 8) != 0)
+	{
+		std::cerr << argv[1] << " is not a trace file" << std::endl;
+		return 1;
+	}
+	if(header.version != 2 || header.recordSize != sizeof(SIOTraceRecord))
+	{
+		std::cerr << "unsupported trace version " << header.version << " (record of " << header.recordSize << " bytes)" << std::endl;
+		return 1;
+	}
+
+	SIOTraceRecord r;
+	long records = 0;
+	while(fread(&r, sizeof(r), 1, f) == 1)
+	{
+		++records;
+		if(only >= 0 && r.connection != (Poco::UInt32)only)
+			continue;
+
+		time_t seconds = (time_t)(r.timestamp / 1000000);
+		struct tm tm;
+		gmtime_r(&seconds, &tm);
+		char when[32];
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+		std::size_t size = r.size <= SIO_TRACE_PAYLOAD ? r.size : SIO_TRACE_PAYLOAD;
+		printf("%s.%06u #%u %s %s%s %u %s%s\n", when, (unsigned)(r.timestamp % 1000000), (unsigned)r.connection,
+			r.direction == SIOTracer::OUT ? "->" : "<-", opcodeName(r.flags), (r.flags & 0x40) ? "+DEFLATE" : "",
+			(unsigned)r.length, escape(r.data, size).c_str(), size < r.length ? "..." : "");
+	}
+	fclose(f);
+	std::cerr << records << " records" << std::endl;
+	return 0;
+}